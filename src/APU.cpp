@@ -1,28 +1,88 @@
 #include "APU.hpp"
 #include "Bus.hpp"
+#include "StateArchive.hpp"
 
 
-void APU::clock()
+APU::APU(Bus& bus) :
+	dmc_{ bus }
 {
-	/*clock frame sequencer*/
-	triangle_.clock();
-	dmc_.clock();
-	if (cpu_cycle_count_ % 2 == 0)
+	setSampleRate(default_sample_rate);
+}
+
+void APU::run(u32 cycles)
+{
+	while (cycles > 0)
 	{
-		pulse1_.clock();
-		pulse2_.clock();		
-		noise_.clock();
-		clockFrameCounter();
+		u32 step = 1;
+		if (!output_dirty_)
+		{
+			step = std::min({ cycles, cyclesUntilFrameEvent(), cyclesUntilOutputChange() });
+		}
+
+		// the pulse and noise timers only run on even cycles
+		const u32 half_clocks = (cpu_cycle_count_ % 2 == 0) ? (step + 1) / 2 : step / 2;
+		triangle_.advance(step);
+		dmc_.advance(step);
+		pulse1_.advance(half_clocks);
+		pulse2_.advance(half_clocks);
+		noise_.advance(half_clocks);
+
+		// nothing but the last cycle of the step can hold a frame event
+		cpu_cycle_count_ += step - 1;
+		frame_cycle_ += step - 1;
+		if (cpu_cycle_count_ % 2 == 0)
+		{
+			clockFrameCounter();
+		}
+
+		mix();
+		++cpu_cycle_count_;
+		++frame_cycle_;
+		output_dirty_ = false;
+		cycles -= step;
 	}
+}
 
-	mix();
-	++cpu_cycle_count_;
-	
+u32 APU::cyclesUntilFrameEvent() const
+{
+	static constexpr std::array<int, 4> events_4step = { 3728, 7456, 11186, 14914 };
+	static constexpr std::array<int, 4> events_5step = { 3728, 7456, 11186, 18640 };
+
+	for (const int event : (frame_sequencer_mode_ ? events_5step : events_4step))
+	{
+		if (event >= cpu_cycle_count_)
+		{
+			return static_cast<u32>(event - cpu_cycle_count_) + 1;
+		}
+	}
+	// past the last event the next even cycle wraps the count around
+	return (cpu_cycle_count_ % 2 == 0) ? 1 : 2;
+}
+
+u32 APU::cyclesUntilOutputChange() const
+{
+	// a half-speed timer clock falls on the first cycle if it is even
+	const u32 odd = cpu_cycle_count_ % 2;
+	const auto halfClocksToCycles = [odd](const u32 clocks) { return 2 * clocks - 1 + odd; };
+
+	u32 cycles = ~0u;
+	if (pulse1_.isAudible())
+		cycles = std::min(cycles, halfClocksToCycles(pulse1_.clocksUntilStep()));
+	if (pulse2_.isAudible())
+		cycles = std::min(cycles, halfClocksToCycles(pulse2_.clocksUntilStep()));
+	if (noise_.isAudible())
+		cycles = std::min(cycles, halfClocksToCycles(noise_.clocksUntilStep()));
+	if (triangle_.isAudible())
+		cycles = std::min(cycles, triangle_.clocksUntilStep());
+	if (const auto dmc = dmc_.clocksUntilChange(); dmc.has_value())
+		cycles = std::min(cycles, *dmc);
+	return cycles;
 }
 
 void APU::regWrite(const u16 addr, const u8 data)
 {
 	assert(addr <= 0x4013 || addr == 0x4015 || addr == 0x4017);
+	output_dirty_ = true;
 
 	const auto getLenCntValue = [](u8 data) -> u8 {
 		data >>= 3;
@@ -190,15 +250,177 @@ u8 APU::regRead(u16 addr)
 	return data;
 }
 
+void APU::endFrame()
+{
+	if (hold_)
+	{
+		assert(held_count_ < max_held_frames);
+		HeldFrame& frame = held_[(held_head_ + held_count_) % max_held_frames];
+		frame.cycles = frame_cycle_;
+		frame.outputs = last_outputs_;
+		frame.amplitude = last_amplitude_;
+		++held_count_;
+	}
+	else
+	{
+		outputFrame(frame_cycle_);
+		played_outputs_ = last_outputs_;
+		played_amplitude_ = last_amplitude_;
+	}
+	frame_cycle_ = 0;
+}
+
+void APU::holdOutput(const bool hold)
+{
+	// frames are played in order, so nothing may be played past held ones
+	assert(hold || held_count_ == 0);
+	hold_ = hold;
+}
+
+void APU::playHeldFrame()
+{
+	assert(held_count_ > 0);
+	HeldFrame& frame = held_[held_head_];
+	for (const Delta& d : frame.deltas)
+	{
+		blip_.addDelta(d.time, d.delta);
+	}
+	outputFrame(frame.cycles);
+	played_outputs_ = frame.outputs;
+	played_amplitude_ = frame.amplitude;
+	frame.deltas.clear();
+	held_head_ = (held_head_ + 1) % max_held_frames;
+	--held_count_;
+}
+
+void APU::dropHeldFrames()
+{
+	for (HeldFrame& frame : held_)
+	{
+		frame.deltas.clear();
+	}
+	held_count_ = 0;
+	last_outputs_ = played_outputs_;
+	last_amplitude_ = played_amplitude_;
+}
+
+usize APU::heldFrames() const
+{
+	return held_count_;
+}
+
+void APU::outputFrame(const u32 cycles)
+{
+	blip_.endFrame(cycles);
+	frame_samples_.resize(blip_.samplesAvail());
+	const usize count = blip_.readSamples(frame_samples_.data(), frame_samples_.size());
+	audio_buf_.write(frame_samples_.data(), count);
+}
+
+void APU::setSampleRate(const double rate)
+{
+	blip_.setRates(cpu_clock_rate, rate);
+	frame_cycle_ = 0;
+}
+
+void APU::setRateAdjust(const double ratio)
+{
+	blip_.setRateScale(ratio);
+}
+
 void APU::getSamples(std::vector<i16>& buf)
 {
-	audio_buf_.copyAll(buf);
+	buf.resize(audio_buf_.size());
+	buf.resize(audio_buf_.read(buf.data(), buf.size()));
+}
+
+usize APU::readSamples(i16* const out, const usize count)
+{
+	return audio_buf_.read(out, count);
+}
+
+AudioBuffer::Stats APU::audioStats() const
+{
+	return audio_buf_.stats();
+}
+
+std::optional<u32> APU::cyclesUntilIRQEvent() const
+{
+	return dmc_.clocksUntilFetch();
+}
+
+void APU::insertCartridge()
+{
+	dmc_.clearCache();
 }
 
 void APU::reset()
 {
 }
 
+void APU::serialize(StateArchive& ar)
+{
+	ar(status_, frame_sequencer_mode_, irq_inhibit_flag_, frame_interrupt_, cpu_cycle_count_, dmc_irq);
+	pulse1_.serialize(ar);
+	pulse2_.serialize(ar);
+	triangle_.serialize(ar);
+	noise_.serialize(ar);
+	dmc_.serialize(ar);
+	if (ar.loading())
+	{
+		output_dirty_ = true; // step the mixed output to the loaded channels
+	}
+}
+
+void Channel::serialize(StateArchive& ar)
+{
+	ar(len_cnt_, enable_, len_cnt_halt_);
+}
+
+void PulseChannel::serialize(StateArchive& ar)
+{
+	Channel::serialize(ar);
+	ar(is_constant, constant_volume, timer, timer_reset, target_period, envelope_, sweep_, duty_, step_);
+}
+
+void TriangleChannel::serialize(StateArchive& ar)
+{
+	Channel::serialize(ar);
+	ar(timer, timer_reset, counter_on_, counter_reload_flag_, counter_reload_value_, counter_value, position);
+}
+
+void NoiseChannel::serialize(StateArchive& ar)
+{
+	Channel::serialize(ar);
+	ar(is_constant, mode_, constant_volume, timer, timer_reset, shift_reg, lfsr_, envelope_);
+}
+
+void DMAReader::serialize(StateArchive& ar)
+{
+	ar(sample_addr_, cur_addr_, sample_len_, cur_len_, loop_, irq_enable_, irq_, disable_);
+}
+
+void DMCOutputUnit::serialize(StateArchive& ar)
+{
+	reader_.serialize(ar);
+	ar(shift_reg_, volume_, counter_, silence_, restart_);
+	if (ar.loading())
+	{
+		cached_levels_ = nullptr;
+	}
+}
+
+void Divider::serialize(StateArchive& ar)
+{
+	ar(period_, counter_);
+}
+
+void DMC::serialize(StateArchive& ar)
+{
+	divider_.serialize(ar);
+	output_.serialize(ar);
+}
+
 void APU::clockFrameCounter()
 {
 	if (!frame_sequencer_mode_)
@@ -294,14 +516,34 @@ void APU::clockSweeps(){
 
 void APU::mix()
 {
-	uint8_t p1 = pulse1_.getOutput();
-	uint8_t p2 = pulse2_.getOutput();
-	uint8_t t = triangle_.getOutput();
-	uint8_t n = noise_.getOutput();
-	uint8_t d = dmc_.getOutput();
-	float value = pulse1_.table[(p1 + p2) & 0x1F] + triangle_.table[3 * t + 2 * n + d];
-	//float value = triangle_.table[2 * n];
-	audio_buf_.write(static_cast<i16>(value * 32767.0f));
+	const uint8_t p1 = pulse1_.getOutput();
+	const uint8_t p2 = pulse2_.getOutput();
+	const uint8_t t = triangle_.getOutput();
+	const uint8_t n = noise_.getOutput();
+	const uint8_t d = dmc_.getOutput();
+	const u32 outputs = p1 | (p2 << 4) | (t << 8) | (n << 12) | (d << 16);
+	if (outputs == last_outputs_)
+	{
+		return;
+	}
+	last_outputs_ = outputs;
+
+	const float value = pulse1_.table[(p1 + p2) & 0x1F] + triangle_.table[3 * t + 2 * n + d];
+	addDelta(static_cast<i32>(value * 32767.0f));
+}
+
+void APU::addDelta(const i32 amplitude)
+{
+	const i32 delta = amplitude - last_amplitude_;
+	last_amplitude_ = amplitude;
+	if (hold_)
+	{
+		held_[(held_head_ + held_count_) % max_held_frames].deltas.push_back({ frame_cycle_, delta });
+	}
+	else
+	{
+		blip_.addDelta(frame_cycle_, delta);
+	}
 }
 
 void Channel::clockLenCnt()
@@ -341,7 +583,7 @@ void Channel::loadLenCnt(const u8 value)
 
 uint8_t PulseChannel::getOutput()
 {
-	static u8 sequences[4][8] =
+	static constexpr u8 sequences[4][8] =
 	{
 		{ 0, 1, 0, 0, 0, 0, 0, 0 }, // 12.5%
 		{ 0, 1, 1, 0, 0, 0, 0, 0 }, // 25%
@@ -361,6 +603,18 @@ uint8_t PulseChannel::getOutput()
 	//return sequences[duty_][step_];
 }
 
+void PulseChannel::advance(const u32 clocks)
+{
+	const u32 steps = advanceTimer(timer, timer_reset, clocks);
+	step_ = static_cast<int>((step_ + steps) % 8);
+}
+
+bool PulseChannel::isAudible() const
+{
+	const u8 volume = is_constant ? constant_volume : envelope_.decay_level_;
+	return !isSilenced() && !isSweepMuted() && volume > 0;
+}
+
 uint8_t TriangleChannel::getOutput(){
 	if (counter_value == 0 || isSilenced()){
 		return 0;
@@ -369,6 +623,17 @@ uint8_t TriangleChannel::getOutput(){
 	return sequence[position];
 }
 
+void TriangleChannel::advance(const u32 clocks)
+{
+	const u32 steps = advanceTimer(timer, timer_reset, clocks);
+	position = static_cast<uint8_t>((position + steps) % 32);
+}
+
+bool TriangleChannel::isAudible() const
+{
+	return counter_value != 0 && !isSilenced();
+}
+
 uint8_t NoiseChannel::getOutput(){
 	if (isSilenced() || lfsr_ & 1){
 		return 0;
@@ -381,40 +646,79 @@ uint8_t NoiseChannel::getOutput(){
 	}
 }
 
-void AudioBuffer::write(const i16 value)
+void NoiseChannel::advance(const u32 clocks)
+{
+	const u32 steps = advanceTimer(timer, timer_reset, clocks);
+	if (steps > 0)
+	{
+		lfsr_ = table.advance(mode_, lfsr_, steps);
+	}
+}
+
+bool NoiseChannel::isAudible() const
+{
+	const u8 volume = is_constant ? constant_volume : envelope_.decay_level_;
+	return !isSilenced() && volume > 0;
+}
+
+u32 clocksUntilStep(const u16 timer)
 {
-	static int max_sample_count = 40;
-	static int sample_count = 0;
-	static double sample_sum = 0.0;
+	return (timer == 0) ? 0x10000 : timer;
+}
 
-	sample_sum += static_cast<double>(value);
-	++sample_count;
-	if (sample_count >= max_sample_count)
+u32 advanceTimer(u16& timer, const u16 reload, const u32 clocks)
+{
+	const u32 first = clocksUntilStep(timer);
+	if (clocks < first)
 	{
-		sample_sum /= static_cast<double>(sample_count);
+		timer = static_cast<u16>(timer - clocks);
+		return 0;
+	}
+	const u32 period = clocksUntilStep(reload);
+	const u32 rest = clocks - first;
+	timer = static_cast<u16>(reload - rest % period);
+	return 1 + rest / period;
+}
+
+NoiseTable::NoiseTable()
+{
+	for (usize mode = 0; mode < sequences_.size(); mode++)
+	{
+		Sequence& seq = sequences_[mode];
+		seq.order.reserve(state_count);
+		seq.index.assign(state_count, 0);
+		std::vector<bool> visited(state_count);
 
+		// the register is invertible, so every state sits on exactly one loop
+		for (usize start = 0; start < state_count; start++)
 		{
-			std::lock_guard lock{ mutex_ };
-			samples_.push_back(sample_sum);
+			if (visited[start])
+			{
+				continue;
+			}
+			seq.loop_starts.push_back(static_cast<u16>(seq.order.size()));
+			u16 lfsr = static_cast<u16>(start);
+			do
+			{
+				visited[lfsr] = true;
+				seq.index[lfsr] = static_cast<u16>(seq.order.size());
+				seq.order.push_back(lfsr);
+				const u16 feedback = (lfsr ^ (mode ? (lfsr >> 6) : (lfsr >> 1))) & 1;
+				lfsr = (lfsr >> 1) | (feedback << 14);
+			} while (lfsr != start);
 		}
-
-		// for(int i = 0; i < samples_.size(); i++){
-		// 	std::cout<<samples_[i]<<" "<<std::endl;
-		// }
-		// std::cout<<"================================"<<std::endl;
-
-		sample_count = 0;
-		sample_sum = 0.0;
-		max_sample_count = (max_sample_count == 40) ? 41 : 40;
 	}
 }
 
-void AudioBuffer::copyAll(std::vector<i16>& buf)
+u16 NoiseTable::advance(const bool mode, const u16 lfsr, const u32 steps) const
 {
-	buf.clear();
-	std::lock_guard lock{ mutex_ };
-	buf.assign(samples_.cbegin(), samples_.cend());
-	samples_.clear();
+	const Sequence& seq = sequences_[mode];
+	const usize index = seq.index[lfsr];
+	const auto next = std::upper_bound(seq.loop_starts.begin(), seq.loop_starts.end(), index);
+	const usize first = *(next - 1);
+	const usize last = (next == seq.loop_starts.end()) ? state_count : *next;
+	const usize length = last - first;
+	return seq.order[first + (index - first + steps) % length];
 }
 
 void PulseChannel::clockEnvelope(){
@@ -538,6 +842,11 @@ void PulseChannel::calculateSweepPeriod(){
 	}
 }
 
+DMAReader::DMAReader(Bus& bus) :
+	bus_{ bus }
+{
+}
+
 void DMAReader::writeSampleAddr(const u8 data)
 {
 	const auto A = static_cast<u16>(data);
@@ -562,7 +871,7 @@ void DMAReader::setIrqEnable(const bool enable)
 
 u8 DMAReader::getSample()
 {
-	const auto sample = Bus::instance().cpuRead(cur_addr_);
+	const auto sample = bus_.dmcRead(cur_addr_);
 	if (cur_len_ > 0)
 	{
 		if (cur_addr_ == 0xFFFF)
@@ -578,11 +887,62 @@ u8 DMAReader::getSample()
 	else if (!disable_)
 	{
 		irq_ = true;
-		Bus::instance().apu.dmc_irq = true;
+		bus_.apu.dmc_irq = true;
 	}
 	return sample;
 }
 
+void DMAReader::skipSample()
+{
+	if (cur_len_ > 0)
+	{
+		if (cur_addr_ == 0xFFFF)
+			cur_addr_ = 0x8000;
+		else
+			++cur_addr_;
+		--cur_len_;
+	}
+	else if (loop_)
+	{
+		restart();
+	}
+	else if (!disable_)
+	{
+		irq_ = true;
+		bus_.apu.dmc_irq = true;
+	}
+}
+
+bool DMAReader::atSampleStart() const
+{
+	return cur_addr_ == sample_addr_ && cur_len_ == sample_len_;
+}
+
+u16 DMAReader::currentAddr() const
+{
+	return cur_addr_;
+}
+
+u16 DMAReader::remaining() const
+{
+	return cur_len_;
+}
+
+u16 DMAReader::sampleLength() const
+{
+	return sample_len_;
+}
+
+const u8* DMAReader::sampleData() const
+{
+	return bus_.dmcSampleData(sample_addr_, sample_len_);
+}
+
+u32 DMAReader::bankGeneration() const
+{
+	return bus_.cartridge().prgBankGeneration();
+}
+
 bool DMAReader::isEmpty() const
 {
 	return cur_len_ == 0;
@@ -608,9 +968,18 @@ void DMAReader::restart()
 	disable_ = false;
 }
 
+DMCOutputUnit::DMCOutputUnit(Bus& bus) :
+	reader_{ bus }
+{
+}
+
 void DMCOutputUnit::update()
 {
-	if (!silence_)
+	if (!silence_ && cached_levels_ != nullptr)
+	{
+		volume_ = cached_levels_[cached_pos_++];
+	}
+	else if (!silence_)
 	{
 		bool b0 = getBitN(shift_reg_, 0);
 		if (b0 && volume_ + 2 <= 127)
@@ -637,14 +1006,103 @@ void DMCOutputUnit::update()
 		else
 		{
 			silence_ = false;
-			shift_reg_ = reader_.getSample();
+			loadSample();
+		}
+	}
+}
+
+void DMCOutputUnit::loadSample()
+{
+	if (cached_levels_ != nullptr && !followsCache())
+	{
+		cached_levels_ = nullptr;
+	}
+	if (cached_levels_ == nullptr && reader_.atSampleStart())
+	{
+		if (const u8* const data = reader_.sampleData())
+		{
+			cached_levels_ = cache_.levels(data, reader_.sampleLength(), volume_);
+			cached_data_ = data;
+			cached_byte_ = 0;
+			cached_length_ = reader_.sampleLength();
+			cached_generation_ = reader_.bankGeneration();
 		}
 	}
+
+	if (cached_levels_ == nullptr)
+	{
+		shift_reg_ = reader_.getSample();
+		return;
+	}
+	// the DMA still steps through the sample, it just does not read it
+	shift_reg_ = cached_data_[cached_byte_];
+	cached_pos_ = cached_byte_ * 8u;
+	++cached_byte_;
+	reader_.skipSample();
+	cached_addr_ = reader_.currentAddr();
+}
+
+bool DMCOutputUnit::followsCache() const
+{
+	// a bank switch or a register write moved the reader off the cached sample
+	return reader_.currentAddr() == cached_addr_
+		&& reader_.remaining() == cached_length_ - cached_byte_
+		&& reader_.bankGeneration() == cached_generation_;
+}
+
+void DMCOutputUnit::clearCache()
+{
+	cached_levels_ = nullptr;
+	cache_.clear();
 }
 
 void DMCOutputUnit::setVolume(const u8 volume)
 {
 	volume_ = volume;
+	cached_levels_ = nullptr; // the cached levels assume the starting level
+}
+
+const u8* DMCSampleCache::levels(const u8* const data, const u16 length, const u8 level)
+{
+	for (const Entry& entry : entries_)
+	{
+		if (entry.data == data && entry.length == length && entry.level == level)
+		{
+			return entry.levels.data();
+		}
+	}
+
+	if (entries_.size() >= max_entries)
+	{
+		entries_.clear();
+	}
+	Entry& entry = entries_.emplace_back();
+	entry.data = data;
+	entry.length = length;
+	entry.level = level;
+	entry.levels.resize(length * 8u);
+
+	u8 volume = level;
+	for (usize i = 0; i < entry.levels.size(); i++)
+	{
+		// the same steps as DMCOutputUnit::update
+		const bool bit = getBitN(data[i / 8], static_cast<unsigned>(i % 8));
+		if (bit && volume + 2 <= 127)
+		{
+			volume += 2;
+		}
+		else if (!bit && volume >= 2)
+		{
+			volume -= 2;
+		}
+		entry.levels[i] = volume;
+	}
+	return entry.levels.data();
+}
+
+void DMCSampleCache::clear()
+{
+	entries_.clear();
 }
 
 u8 DMCOutputUnit::getOutput() const
@@ -657,6 +1115,28 @@ void DMCOutputUnit::restart()
 	restart_ = true;
 }
 
+bool DMCOutputUnit::isIdle() const
+{
+	return silence_ && !mayFetch();
+}
+
+void DMCOutputUnit::skipUpdates(const u32 updates)
+{
+	// what update() does while idle: shift the register and count the bits
+	shift_reg_ = (updates >= 8) ? 0 : static_cast<u8>(shift_reg_ >> updates);
+	counter_ = static_cast<int>((static_cast<u32>(counter_) + 7 - updates % 8) % 8) + 1;
+}
+
+bool DMCOutputUnit::mayFetch() const
+{
+	return restart_ || !reader_.isEmpty();
+}
+
+u32 DMCOutputUnit::updatesUntilFetch() const
+{
+	return counter_ > 1 ? static_cast<u32>(counter_) : 1u;
+}
+
 bool Divider::clock()
 {
 	if (counter_ == 0)
@@ -668,6 +1148,24 @@ bool Divider::clock()
 	return false;
 }
 
+u32 Divider::clocksUntilTick() const
+{
+	return counter_ + 1u;
+}
+
+u32 Divider::advance(const u32 clocks)
+{
+	if (clocks < clocksUntilTick())
+	{
+		counter_ -= static_cast<u16>(clocks);
+		return 0;
+	}
+	const u32 period = period_ + 1u;
+	const u32 rest = clocks - clocksUntilTick();
+	counter_ = static_cast<u16>(period_ - rest % period);
+	return 1 + rest / period;
+}
+
 void Divider::setPeriod(const u16 period)
 {
 	period_ = period;
@@ -688,12 +1186,30 @@ u16 Divider::getPeriod() const
 	return period_;
 }
 
-void DMC::clock()
+DMC::DMC(Bus& bus) :
+	output_{ bus }
+{
+}
+
+void DMC::advance(const u32 clocks)
 {
-	if (divider_.clock())
+	if (output_.isIdle())
+	{
+		output_.skipUpdates(divider_.advance(clocks));
+		return;
+	}
+	assert(clocks <= divider_.clocksUntilTick());
+	if (divider_.advance(clocks) > 0)
 		output_.update();
 }
 
+std::optional<u32> DMC::clocksUntilChange() const
+{
+	if (output_.isIdle())
+		return std::nullopt;
+	return divider_.clocksUntilTick();
+}
+
 void DMC::writeFlags(const u8 data)
 {
 	output_.reader_.setIrqEnable(getBitN(data, 7));
@@ -734,6 +1250,18 @@ bool DMC::isSilenced() const
 	return output_.reader_.isEmpty();
 }
 
+std::optional<u32> DMC::clocksUntilFetch() const
+{
+	if (!output_.mayFetch())
+		return std::nullopt;
+	return divider_.clocksUntilTick() + (output_.updatesUntilFetch() - 1) * (divider_.getPeriod() + 1u);
+}
+
+void DMC::clearCache()
+{
+	output_.clearCache();
+}
+
 bool DMC::irq()
 {
 	return output_.reader_.irq();
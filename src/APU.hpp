@@ -1,6 +1,11 @@
 #pragma once
 
 #include "pch.hpp"
+#include "AudioBuffer.hpp"
+#include "BlipBuffer.hpp"
+
+class Bus;
+class StateArchive;
 
 class Channel
 {
@@ -19,7 +24,7 @@ public:
 
 	virtual uint8_t getOutput() { return 0; };
 
-	virtual void clock() {};
+	void serialize(StateArchive& ar);
 
 private:
 	u8 len_cnt_ = 0;
@@ -83,6 +88,35 @@ private:
 	std::array<float, 203> table_;
 };
 
+// A channel timer counts down once per clock and steps the sequencer when it
+// reaches zero, then reloads. Both counts treat 0 as 65536.
+u32 clocksUntilStep(u16 timer);
+u32 advanceTimer(u16& timer, u16 reload, u32 clocks); // returns the steps taken
+
+// Every state of the noise shift register in the order each mode steps
+// through them: one 32767 step sequence (plus the stuck all-zero state) for
+// mode 0, and the 93 and 31 step loops mode 1 splits the states into. Any
+// number of steps is a lookup.
+class NoiseTable
+{
+public:
+	NoiseTable();
+
+	u16 advance(bool mode, u16 lfsr, u32 steps) const;
+
+private:
+	static constexpr usize state_count = 1 << 15;
+
+	struct Sequence
+	{
+		std::vector<u16> order;       // the states, loop after loop
+		std::vector<u16> index;       // state -> position in order
+		std::vector<u16> loop_starts; // position of the first state of every loop
+	};
+
+	std::array<Sequence, 2> sequences_;
+};
+
 class PulseChannel : public Channel
 {
 public:
@@ -95,21 +129,20 @@ public:
 
 	void setDuty(u8 duty) { assert(duty < 4); duty_ = duty; };
 
-	void clock() override { 
-		timer--;
-		if (timer == 0) {
-			timer = timer_reset;
-			step_ = (step_ + 1) % 8;
-		}
-	}
+	// clocks are the APU's half-speed timer clocks
+	void advance(u32 clocks);
+	u32 clocksUntilStep() const { return ::clocksUntilStep(timer); }
+	bool isAudible() const; // whether stepping the sequencer can change the output
 
 	void clockEnvelope();
 	void clockSweep();
 
 	void setStepReset() { step_ = 0; }
 
+	void serialize(StateArchive& ar);
+
 	void calculateSweepPeriod();
-	bool isSweepMuted(){
+	bool isSweepMuted() const {
 		return timer_reset < 8 || target_period > 0x7FF;
 	}
 	
@@ -139,16 +172,14 @@ public:
 
 	static inline TriangleTable table;
 
-	void clock() override { 
-		timer--;
-		if (timer == 0) {
-			timer = timer_reset;
-			position = (position + 1) % 32;
-		}
-	}
+	void advance(u32 clocks);
+	u32 clocksUntilStep() const { return ::clocksUntilStep(timer); }
+	bool isAudible() const;
 
 	void ClockLinearCounter();
 
+	void serialize(StateArchive& ar);
+
 	uint16_t timer = 0;
 	uint16_t timer_reset = 0;
 
@@ -168,18 +199,17 @@ public:
 
 	uint8_t getOutput() override;
 
-	void clock() override { 
-		timer--;
-		if (timer == 0) {
-			timer = timer_reset;
+	static inline const NoiseTable table;
 
-			feedback = (lfsr_ & 1) ^ ((mode_ ? (lfsr_ >> 6) : (lfsr_ >> 1)) & 1);
-			lfsr_ = (lfsr_ >> 1) | (feedback << 14);
-		}
-	}
+	// clocks are the APU's half-speed timer clocks
+	void advance(u32 clocks);
+	u32 clocksUntilStep() const { return ::clocksUntilStep(timer); }
+	bool isAudible() const;
 
 	void clockEnvelope();
 
+	void serialize(StateArchive& ar);
+
 	bool is_constant = true;
 	bool mode_ = false;
 
@@ -190,8 +220,6 @@ public:
 	uint16_t shift_reg = 1;
 	uint16_t lfsr_ = 1;
 
-	int feedback = 0;
-
 
 	Envelope envelope_;
 	const uint16_t noisePeriodTable[16] = {
@@ -203,6 +231,8 @@ public:
 class DMAReader
 {
 public:
+	explicit DMAReader(Bus& bus);
+
 	void writeSampleAddr(u8 data);
 	
 	void writeSampleLen(u8 data);
@@ -213,15 +243,31 @@ public:
 
 	u8 getSample();
 
+	// moves past the next byte like getSample, for a sample played from the cache
+	void skipSample();
+
 	bool isEmpty() const;
 
+	bool atSampleStart() const;
+	u16 currentAddr() const;
+	u16 remaining() const;
+	u16 sampleLength() const;
+
+	// the whole sample as one run of PRG ROM, nullptr if it is not mapped that way
+	const u8* sampleData() const;
+	u32 bankGeneration() const;
+
 	bool irq();
 
 	void clear();
 
 	void restart();
 
+	void serialize(StateArchive& ar);
+
 private:
+	Bus& bus_;
+
 	u16 sample_addr_ = 0, cur_addr_ = 0;
 	u16 sample_len_ = 0, cur_len_ = 0;
 	bool loop_ = true;
@@ -230,9 +276,35 @@ private:
 	bool disable_ = false;
 };
 
+// Sample bytes decoded to the output level after every bit, for one starting
+// level. Games replay the same few samples, so each is decoded once. The
+// returned levels stay valid until the next miss or clear().
+class DMCSampleCache
+{
+public:
+	const u8* levels(const u8* data, u16 length, u8 level);
+
+	void clear();
+
+private:
+	static constexpr usize max_entries = 64;
+
+	struct Entry
+	{
+		const u8* data = nullptr;
+		u16 length = 0;
+		u8 level = 0;
+		std::vector<u8> levels;
+	};
+
+	std::vector<Entry> entries_;
+};
+
 class DMCOutputUnit
 {
 public:
+	explicit DMCOutputUnit(Bus& bus);
+
 	void update();
 
 	void setVolume(u8 volume);
@@ -243,7 +315,34 @@ public:
 
 	void restart();
 
+	bool mayFetch() const; // whether a sample byte may be read at the end of the current one
+	u32 updatesUntilFetch() const;
+
+	// silent with nothing left to read: updates only move the bit counter
+	bool isIdle() const;
+	void skipUpdates(u32 updates);
+
+	void clearCache();
+
+	// drops the cached sample on load, the plain path carries on from the same bits
+	void serialize(StateArchive& ar);
+
 private:
+	void loadSample();
+	bool followsCache() const;
+
+	DMCSampleCache cache_;
+
+	// the sample being played from the cache, if any: the levels of all its
+	// bits, the next one to output and where the reader should be next
+	const u8* cached_levels_ = nullptr;
+	const u8* cached_data_ = nullptr;
+	u32 cached_pos_ = 0;
+	u16 cached_byte_ = 0;
+	u16 cached_length_ = 0;
+	u16 cached_addr_ = 0;
+	u32 cached_generation_ = 0;
+
 	u8 shift_reg_ = 0;
 	u8 volume_ = 0;
 	int counter_ = 8;
@@ -256,6 +355,10 @@ class Divider
 public:
 	bool clock();
 
+	u32 clocksUntilTick() const; // until clock() next returns true
+
+	u32 advance(u32 clocks); // returns the number of ticks
+
 	void setPeriod(u16 reload);
 
 	void reset();
@@ -264,6 +367,8 @@ public:
 
 	u16 getPeriod() const;
 
+	void serialize(StateArchive& ar);
+
 private:
 	u16 period_ = 0, counter_ = 0;
 };
@@ -271,7 +376,14 @@ private:
 class DMC
 {
 public:
-	void clock();
+	explicit DMC(Bus& bus);
+
+	// Runs the given number of clocks. Unless the DMC is idle they must not
+	// go past the next divider tick.
+	void advance(u32 clocks);
+
+	// clocks until the output may change, none while idle
+	std::optional<u32> clocksUntilChange() const;
 
 	void writeFlags(u8 data);
 
@@ -289,6 +401,13 @@ public:
 
 	bool irq();
 
+	// clocks until the next sample byte read, which is the only point the IRQ can be raised
+	std::optional<u32> clocksUntilFetch() const;
+
+	void clearCache();
+
+	void serialize(StateArchive& ar);
+
 private:
 	static constexpr u16 s_period_table[] = 
 	{
@@ -300,24 +419,15 @@ private:
 	DMCOutputUnit output_;
 };
 
-class AudioBuffer
-{
-public:
-	AudioBuffer() { samples_.reserve(30000); }
-
-	void write(i16 value);
-
-	void copyAll(std::vector<i16>& buf);
-
-private:
-	std::vector<i16> samples_;
-	std::mutex mutex_;
-};
-
 class APU
 {
 public:
-	void clock();
+	explicit APU(Bus& bus);
+
+	// Runs the given number of CPU cycles. Time only stops at register
+	// writes, frame sequencer events and clocks where an audible channel
+	// steps; everything in between is advanced in one go.
+	void run(u32 cycles);
 	
 	void regWrite(u16 addr, u8 data);
 
@@ -325,14 +435,50 @@ public:
 
 	void reset();
 
+	// records the mixed output at the current cycle if any channel changed
 	void mix();
 
+	// turns the output changes of the frame into samples for getSamples
+	void endFrame();
+
+	// While holding, endFrame keeps the output changes of each frame back
+	// instead of turning them into samples, for frames run ahead of time that
+	// may be thrown away. playHeldFrame plays the oldest kept frame,
+	// dropHeldFrames forgets all of them.
+	void holdOutput(bool hold);
+	void playHeldFrame();
+	void dropHeldFrames();
+	usize heldFrames() const;
+
+	void setSampleRate(double rate);
+
+	// scales the output rate by ratio, see BlipBuffer::setRateScale
+	void setRateAdjust(double ratio);
+
 	void getSamples(std::vector<i16>& buf);
 
+	// safe to call from another thread than the one running the APU
+	usize readSamples(i16* out, usize count);
+
+	AudioBuffer::Stats audioStats() const;
+
+	// CPU cycles until the DMC may next raise its IRQ, none if it cannot before a register write
+	std::optional<u32> cyclesUntilIRQEvent() const;
+
+	// drops the DMC samples decoded from the previous cartridge
+	void insertCartridge();
+
+	// the frame counter and all channels; the samples already produced stay
+	void serialize(StateArchive& ar);
+
 	bool dmc_irq = false;
 
 private:
 	void clockFrameCounter();
+	u32 cyclesUntilFrameEvent() const;
+	u32 cyclesUntilOutputChange() const;
+	void addDelta(i32 amplitude);
+	void outputFrame(u32 cycles);
 	void clockChannelsLen();
 	void clockEnvelopes();
 	void clockSweeps();
@@ -356,5 +502,39 @@ private:
 		12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
 	};
 
+	static constexpr double cpu_clock_rate = 1789773.0;
+	static constexpr double default_sample_rate = 44100.0;
+
+	BlipBuffer blip_;
+	u32 frame_cycle_ = 0;   // CPU cycles since the last endFrame
+	u32 last_outputs_ = 0;  // the channel outputs packed 4 bits apart, 8 for the DMC
+	i32 last_amplitude_ = 0;
+	bool output_dirty_ = false; // a register write may have changed the output
+	std::vector<i16> frame_samples_;
+
+	struct Delta
+	{
+		u32 time;
+		i32 delta;
+	};
+
+	struct HeldFrame
+	{
+		std::vector<Delta> deltas;
+		u32 cycles = 0;
+		u32 outputs = 0; // the mixer state at the end
+		i32 amplitude = 0;
+	};
+
+	static constexpr usize max_held_frames = 8;
+
+	bool hold_ = false;
+	std::array<HeldFrame, max_held_frames> held_;
+	usize held_head_ = 0; // the oldest
+	usize held_count_ = 0;
+	// the mixer state the last played frame ended with, dropping returns to it
+	u32 played_outputs_ = 0;
+	i32 played_amplitude_ = 0;
+
 	AudioBuffer audio_buf_;
 };
\ No newline at end of file
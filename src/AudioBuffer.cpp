@@ -0,0 +1,64 @@
+#include "AudioBuffer.hpp"
+
+#include <cstring>
+
+
+usize AudioBuffer::write(const i16* const samples, const usize count)
+{
+	const usize head = head_.load(std::memory_order_relaxed);
+	const usize tail = tail_.load(std::memory_order_acquire);
+	const usize n = std::min(count, capacity - (head - tail));
+	if (n < count)
+	{
+		overruns_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// the block may wrap around the end of the array
+	const usize start = head % capacity;
+	const usize first = std::min(n, capacity - start);
+	std::memcpy(&samples_[start], samples, first * sizeof(i16));
+	std::memcpy(&samples_[0], samples + first, (n - first) * sizeof(i16));
+
+	head_.store(head + n, std::memory_order_release);
+	return n;
+}
+
+usize AudioBuffer::read(i16* const out, const usize count)
+{
+	const usize tail = tail_.load(std::memory_order_relaxed);
+	const usize head = head_.load(std::memory_order_acquire);
+	const usize n = std::min(count, head - tail);
+	if (n < count)
+	{
+		underruns_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const usize start = tail % capacity;
+	const usize first = std::min(n, capacity - start);
+	std::memcpy(out, &samples_[start], first * sizeof(i16));
+	std::memcpy(out + first, &samples_[0], (n - first) * sizeof(i16));
+
+	tail_.store(tail + n, std::memory_order_release);
+	return n;
+}
+
+usize AudioBuffer::size() const
+{
+	// tail first: head only grows, so it cannot be read behind it
+	const usize tail = tail_.load(std::memory_order_acquire);
+	return head_.load(std::memory_order_acquire) - tail;
+}
+
+AudioBuffer::Stats AudioBuffer::stats() const
+{
+	Stats stats;
+	stats.underruns = underruns_.load(std::memory_order_relaxed);
+	stats.overruns = overruns_.load(std::memory_order_relaxed);
+	stats.fill = size();
+	return stats;
+}
+
+void AudioBuffer::clear()
+{
+	tail_.store(head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <atomic>
+
+
+// Fixed-size single-producer/single-consumer sample queue between the
+// emulation thread (write) and the audio thread (read). Neither side locks or
+// allocates. The indices only grow, their difference is the fill level.
+class AudioBuffer
+{
+public:
+	static constexpr usize capacity = 16384; // about 370 ms at 44.1 kHz, a power of two
+
+	struct Stats
+	{
+		u64 underruns = 0; // reads that got fewer samples than asked for
+		u64 overruns = 0;  // writes that dropped samples because the queue was full
+		usize fill = 0;
+	};
+
+	// producer side: queues as many of the samples as fit, returns how many
+	usize write(const i16* samples, usize count);
+
+	// consumer side: moves up to count samples into out, returns how many
+	usize read(i16* out, usize count);
+
+	usize size() const;
+
+	Stats stats() const;
+
+	// drops everything queued, only while neither side is running
+	void clear();
+
+private:
+	static constexpr usize cache_line = 64;
+
+	alignas(cache_line) std::atomic<usize> head_{ 0 }; // next slot to write, owned by the producer
+	std::atomic<u64> overruns_{ 0 };
+	alignas(cache_line) std::atomic<usize> tail_{ 0 }; // next slot to read, owned by the consumer
+	std::atomic<u64> underruns_{ 0 };
+	alignas(cache_line) std::array<i16, capacity> samples_{};
+};
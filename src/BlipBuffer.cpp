@@ -0,0 +1,127 @@
+#include "BlipBuffer.hpp"
+
+#include <cmath>
+#include <cstring>
+
+
+BlipBuffer::BlipBuffer()
+{
+	buildKernel();
+}
+
+void BlipBuffer::setRates(const double clock_rate, const double sample_rate)
+{
+	clock_rate_ = clock_rate;
+	sample_rate_ = sample_rate;
+	updateFactor();
+	buf_.assign(static_cast<usize>(sample_rate * max_scale * max_frame_seconds) + kernel_size, 0);
+	clear();
+}
+
+void BlipBuffer::setRateScale(const double scale)
+{
+	scale_ = std::clamp(scale, 1.0 / max_scale, max_scale);
+	updateFactor();
+}
+
+void BlipBuffer::updateFactor()
+{
+	const double rate = sample_rate_ * scale_;
+	factor_ = static_cast<u64>(rate / clock_rate_ * static_cast<double>(1ull << time_bits) + 0.5);
+}
+
+void BlipBuffer::clear()
+{
+	std::fill(buf_.begin(), buf_.end(), 0);
+	offset_ = 0;
+	avail_ = 0;
+	sum_ = 0;
+}
+
+void BlipBuffer::buildKernel()
+{
+	constexpr double pi = 3.14159265358979323846;
+
+	for (int phase = 0; phase < phase_count; phase++)
+	{
+		// tap k lands k - half_width + 1 samples after the sample the step is in
+		const double frac = static_cast<double>(phase) / phase_count;
+		std::array<double, kernel_size> taps{};
+		double total = 0.0;
+		for (int k = 0; k < kernel_size; k++)
+		{
+			const double t = (k - half_width + 1) - frac;
+			const double x = pi * cutoff * t;
+			const double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+			const double w = 0.5 + 0.5 * t / half_width; // Blackman window over [-half_width, half_width]
+			const double window = 0.42 - 0.5 * std::cos(2.0 * pi * w) + 0.08 * std::cos(4.0 * pi * w);
+			taps[k] = sinc * window;
+			total += taps[k];
+		}
+
+		// every phase must add up to exactly one step or the output drifts
+		i32 sum = 0;
+		int peak = 0;
+		for (int k = 0; k < kernel_size; k++)
+		{
+			kernel_[phase][k] = static_cast<i32>(std::lround(taps[k] / total * (1 << kernel_bits)));
+			sum += kernel_[phase][k];
+			if (kernel_[phase][k] > kernel_[phase][peak])
+			{
+				peak = k;
+			}
+		}
+		kernel_[phase][peak] += (1 << kernel_bits) - sum;
+	}
+}
+
+void BlipBuffer::addDelta(const u32 time, const i32 delta)
+{
+	const u64 pos = offset_ + time * factor_;
+	const usize index = avail_ + static_cast<usize>(pos >> time_bits);
+	const usize phase = static_cast<usize>((pos >> (time_bits - phase_bits)) & (phase_count - 1));
+	if (index + kernel_size > buf_.size())
+	{
+		return; // the frame ran longer than the buffer holds
+	}
+
+	i32* const out = &buf_[index];
+	const auto& taps = kernel_[phase];
+	for (int k = 0; k < kernel_size; k++)
+	{
+		out[k] += taps[k] * delta;
+	}
+}
+
+void BlipBuffer::endFrame(const u32 time)
+{
+	const u64 pos = offset_ + time * factor_;
+	avail_ = std::min(avail_ + static_cast<usize>(pos >> time_bits), buf_.size() - kernel_size);
+	offset_ = pos & ((1ull << time_bits) - 1);
+}
+
+usize BlipBuffer::samplesAvail() const
+{
+	return avail_;
+}
+
+usize BlipBuffer::readSamples(i16* const out, usize count)
+{
+	count = std::min(count, avail_);
+	i64 sum = sum_;
+	for (usize i = 0; i < count; i++)
+	{
+		sum += buf_[i];
+		const i64 s = sum >> kernel_bits;
+		out[i] = static_cast<i16>(std::clamp<i64>(s, -32768, 32767));
+		sum -= s << (kernel_bits - bass_shift);
+	}
+	sum_ = sum;
+
+	// move the unread samples and the tails of the last steps to the front
+	const usize remain = avail_ - count + kernel_size;
+	std::memmove(buf_.data(), buf_.data() + count, remain * sizeof(i32));
+	std::fill_n(buf_.data() + remain, count, 0);
+	avail_ -= count;
+	return count;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.hpp"
+
+
+// Band-limited step synthesis. The producer records only the changes of its
+// output, each at the clock it happened on; every change is added to the
+// buffer as a windowed-sinc step, so reading the buffer back is just a running
+// sum that is already low-passed to the output rate. A slow leak on the sum
+// removes the DC offset. Output comes out half_width - 1 samples late.
+class BlipBuffer
+{
+public:
+	BlipBuffer();
+
+	// clock_rate is the rate of the times given to addDelta
+	void setRates(double clock_rate, double sample_rate);
+
+	// produces sample_rate * scale samples per second of clocks from now on,
+	// for small corrections that keep the queued output at a steady level
+	void setRateScale(double scale);
+
+	void clear();
+
+	// adds an output change at `time` clocks after the start of the frame
+	void addDelta(u32 time, i32 delta);
+
+	// ends the frame `time` clocks after its start and makes the samples before
+	// it readable, the next frame starts there
+	void endFrame(u32 time);
+
+	usize samplesAvail() const;
+
+	// moves up to count samples into out, returns how many were read
+	usize readSamples(i16* out, usize count);
+
+private:
+	static constexpr int half_width = 8; // kernel taps on each side of a step
+	static constexpr int kernel_size = 2 * half_width;
+	static constexpr int phase_bits = 6;
+	static constexpr int phase_count = 1 << phase_bits;
+	static constexpr int kernel_bits = 15; // the taps of every phase sum to 1 << kernel_bits
+	static constexpr int bass_shift = 9;   // DC leak, about 14 Hz at 44.1 kHz
+	static constexpr int time_bits = 32;   // fraction bits of a sample position
+	static constexpr double cutoff = 0.9;  // of the output Nyquist frequency
+	static constexpr double max_frame_seconds = 0.125;
+	static constexpr double max_scale = 1.05;
+
+	void buildKernel();
+	void updateFactor();
+
+	std::array<std::array<i32, kernel_size>, phase_count> kernel_{};
+
+	double clock_rate_ = 1.0;
+	double sample_rate_ = 1.0;
+	double scale_ = 1.0;
+	u64 factor_ = 0; // output samples per clock, time_bits fraction
+	u64 offset_ = 0; // fraction of a sample the current frame starts at
+	usize avail_ = 0;
+	i64 sum_ = 0;
+	std::vector<i32> buf_;
+};
@@ -1,128 +1,302 @@
 #include "Bus.hpp"
+#include "StateArchive.hpp"
 
 Bus::Bus() : 
-	cpu_mem_(cpu_mem_size)
+	ppu{ *this },
+	cpu{ *this },
+	apu{ *this }
 {
-}
-
-Bus& Bus::instance()
-{
-	static Bus bus;
-	return bus;
+	for (usize i = 0; i < CPUPage::count; i++)
+	{
+		const u16 addr = static_cast<u16>(i * CPUPage::size);
+		if (addr <= 0x1FFF)
+		{
+			u8* const ram = &memory_.ram[addr & 0x07FF];
+			cpu_pages_[i] = { ram, ram };
+			cpu_page_handlers_[i] = PageHandler::None;
+		}
+		else if (addr <= 0x3FFF)
+		{
+			cpu_page_handlers_[i] = PageHandler::PPU;
+		}
+		else if (addr == 0x4000)
+		{
+			cpu_page_handlers_[i] = PageHandler::IO;
+		}
+		else
+		{
+			cpu_page_handlers_[i] = PageHandler::Cartridge;
+		}
+	}
 }
 
 void Bus::cpuWrite(const u16 addr, const u8 data)
 {
-	if (cart_->cpuMapWrite(addr, data))
+	const usize page = addr / CPUPage::size;
+	if (u8* const mem = cpu_pages_[page].write)
 	{
+		mem[addr & (CPUPage::size - 1)] = data;
+		return;
 	}
-	else if (addr <= 0x1FFF)
-	{
-		cpu_mem_[addr & 0x07FF] = data;
-	}
-	else if (0x2000 <= addr && addr <= 0x3FFF)
+
+	catchUp(cpu_time_);
+	switch (cpu_page_handlers_[page])
 	{
+	case PageHandler::PPU:
 		ppu.regWrite(addr & 0x0007, data);
+		break;
+
+	case PageHandler::IO:
+		if (addr == 0x4014)
+		{
+			dma_transfer = true;
+			dma_addr = (static_cast<u16>(data) << 8);
+			oam_addr = ppu.getOAMAddr();
+			dma_start = false;
+		}
+		else if (addr <= 0x4013 || addr == 0x4015 || addr == 0x4017)
+		{
+			apu.regWrite(addr, data);
+		}
+		else if (addr == 0x4016)
+		{
+			joystick.setStrobe(data);
+			joystick_cache_ = joystick;
+		}
+		else if (addr >= 0x4020)
+		{
+			cart_->cpuMapWrite(addr, data);
+		}
+		break;
+
+	case PageHandler::Cartridge:
+		cart_->cpuMapWrite(addr, data);
+		break;
+
+	default:
+		break;
 	}
-	else if (addr == 0x4014)
-	{
-		dma_transfer = true;
-		dma_addr = (static_cast<u16>(data) << 8);
-		oam_addr = ppu.getOAMAddr();
-		dma_start = false;
-	}
-	else if (addr <= 0x4013 || addr == 0x4015 || addr == 0x4017)
+	scheduleEvent();
+}
+
+u8 Bus::cpuRead(const u16 addr)
+{
+	const usize page = addr / CPUPage::size;
+	if (const u8* const mem = cpu_pages_[page].read)
 	{
-		apu.regWrite(addr, data);
+		return mem[addr & (CPUPage::size - 1)];
 	}
-	else if (addr == 0x4016)
+
+	catchUp(cpu_time_);
+	switch (cpu_page_handlers_[page])
 	{
-		joystick.setStrobe(data);
-		joystick_cache_ = joystick;
+	case PageHandler::PPU:
+		return ppu.regRead(addr & 0x0007);
+
+	case PageHandler::IO:
+		if (addr == 0x4015)
+		{
+			return apu.regRead(addr);
+		}
+		if (addr == 0x4016)
+		{
+			return joystick_cache_.report();
+		}
+		if (addr < 0x4020)
+		{
+			return 0;
+		}
+		[[fallthrough]];
+
+	case PageHandler::Cartridge:
+		if (const auto data = cart_->cpuMapRead(addr); data.has_value())
+		{
+			return *data;
+		}
+		return 0;
+
+	default:
+		return 0;
 	}
 }
 
-u8 Bus::cpuRead(const u16 addr)
+u8 Bus::dmcRead(const u16 addr)
 {
-	if (const auto data = cart_->cpuMapRead(addr); data.has_value())
+	if (const u8* const mem = cpu_pages_[addr / CPUPage::size].read)
 	{
-		return *data;
+		return mem[addr & (CPUPage::size - 1)];
 	}
-	else if (addr <= 0x1FFF)
+	if (const auto data = cart_->cpuMapRead(addr); data.has_value())
 	{
-		return cpu_mem_[addr & 0x07FF];
+		return *data;
 	}
-	else if (0x2000 <= addr && addr <= 0x3FFF)
+	return 0;
+}
+
+const u8* Bus::dmcSampleData(const u16 addr, const u16 length) const
+{
+	const u8* data = nullptr;
+	for (u32 i = 0; i < length;)
 	{
-		return ppu.regRead(addr & 0x0007);
+		// the DMC wraps from $FFFF to $8000
+		u32 at = addr + i;
+		if (at > 0xFFFF)
+			at = at - 0x10000 + 0x8000;
+
+		const CPUPage& page = cpu_pages_[at / CPUPage::size];
+		if (page.read == nullptr || page.write != nullptr)
+			return nullptr;
+		const u8* const mem = page.read + (at % CPUPage::size);
+		if (i == 0)
+			data = mem;
+		else if (mem != data + i)
+			return nullptr;
+		i += CPUPage::size - (at % CPUPage::size);
 	}
-	else if (addr == 0x4015)
+	return data;
+}
+
+void Bus::runFrame()
+{
+	while (!ppu.frame_complete)
 	{
-		return apu.regRead(addr);
+		while (cpu_time_ < next_event_)
+		{
+			cpuCycle();
+		}
+		catchUp(next_event_);
+		scheduleEvent();
 	}
-	else if (addr == 0x4016)
+	// the CPU cycle on the master cycle the frame ended on still belongs to it
+	if (cpu_time_ < ppu_time_)
 	{
-		return joystick_cache_.report();
+		cpuCycle();
 	}
-	return 0;
+	ppu.frame_complete = false;
+	apu.endFrame();
 }
 
-void Bus::clock()
+void Bus::cpuCycle()
 {
-	ppu.cycle();
-
-	if (cycle_ % 3 == 0)
+	if (dma_transfer)
 	{
-		apu.clock();
-
-		if (dma_transfer)
+		if (!dma_start)
 		{
-			if (!dma_start)
+			if (oamDMAPage())
 			{
-				if (cycle_ % 2 == 1)
-				{
-					dma_start = true;
-				}
+				return;
 			}
-			else
+			if (cpu_time_ % 2 == 1)
 			{
-				if (cycle_ % 2 == 1)
-				{
-					const u8 data = cpuRead(dma_addr++);
-					ppu.OAM()[oam_addr++] = data;
-					if ((dma_addr & 0x00FF) == 0x0000)
-					{
-						dma_transfer = false;
-					}
-				}
+				dma_start = true;
 			}
 		}
 		else
 		{
-			if (ppu.nmi && cpu.nmi()) 
+			if (cpu_time_ % 2 == 1)
 			{
-				ppu.nmi = false;
-			}
-			if (apu.dmc_irq && cpu.irq()) 
-			{
-				apu.dmc_irq = false;
-			}
-			if (cart_->irq && cpu.irq()) 
-			{
-				cart_->irq = false;
+				const u8 data = cpuRead(dma_addr++);
+				catchUp(cpu_time_);
+				ppu.writeOAM(oam_addr++, data);
+				if ((dma_addr & 0x00FF) == 0x0000)
+				{
+					dma_transfer = false;
+				}
 			}
-			cpu.cycle();
 		}
 	}
+	else
+	{
+		if (ppu.nmi && cpu.nmi()) 
+		{
+			ppu.nmi = false;
+		}
+		if (apu.dmc_irq && cpu.irq()) 
+		{
+			apu.dmc_irq = false;
+		}
+		if (cart_->irq && cpu.irq()) 
+		{
+			cart_->irq = false;
+		}
+		cpu.cycle();
+	}
 
-	++cycle_;
+	cpu_time_ += 3;
+}
+
+bool Bus::oamDMAPage()
+{
+	const u8* const page = cpu_pages_[dma_addr / CPUPage::size].read;
+	if (!page)
+	{
+		return false;
+	}
+
+	// one or two cycles to line up, then a read and a write cycle per byte
+	const u64 stall = (cpu_time_ % 2 == 1) ? 513 : 514;
+	catchUp(cpu_time_);
+	if (ppu.dotsUntilOAMRead() <= 3 * stall)
+	{
+		return false; // sprite evaluation would see the bytes land one by one
+	}
+
+	ppu.writeOAMPage(oam_addr, page + (dma_addr & (CPUPage::size - 1)));
+	dma_transfer = false;
+	cpu_time_ += 3 * stall;
+	return true;
+}
+
+void Bus::catchUp(const u64 time)
+{
+	if (ppu_time_ <= time)
+	{
+		const u64 dots = time - ppu_time_ + 1;
+		ppu.run(static_cast<u32>(dots));
+		ppu_time_ += dots;
+	}
+	if (apu_time_ <= time)
+	{
+		const u64 cycles = (time - apu_time_) / 3 + 1;
+		apu.run(static_cast<u32>(cycles));
+		apu_time_ += 3 * cycles;
+	}
+}
+
+void Bus::scheduleEvent()
+{
+	// the odd frame dot skip may bring the PPU event one dot closer
+	next_event_ = ppu_time_ + std::max(ppu.dotsUntilEvent(), 1u) - 1;
+	if (const auto cycles = apu.cyclesUntilIRQEvent(); cycles.has_value())
+	{
+		next_event_ = std::min(next_event_, apu_time_ + 3 * (*cycles - 1));
+	}
 }
 
 void Bus::reset()
 {
-	cycle_ = 0;
+	cpu_time_ = ppu_time_ = apu_time_ = 0;
 	cpu.reset();
 	ppu.reset();
+	scheduleEvent();
+}
+
+u8* const Bus::RAM()
+{
+	return memory_.ram.data();
+}
+
+MachineMemory& Bus::memory()
+{
+	return memory_;
+}
+
+u32 Bus::cpuRunAheadBudget() const
+{
+	if (dma_transfer || ppu.nmi || apu.dmc_irq || cart_->irq)
+		return 0;
+	// every poll up to the last cycle of the block must come before the next event
+	return static_cast<u32>((next_event_ - cpu_time_ + 2) / 3);
 }
 
 Mapper& Bus::cartridge()
@@ -130,8 +304,76 @@ Mapper& Bus::cartridge()
 	return *cart_;
 }
 
+usize Bus::saveState(u8* const buffer, const usize size)
+{
+	StateArchive ar = StateArchive::writer(buffer, size);
+	serialize(ar);
+	return ar.size();
+}
+
+void Bus::loadState(const u8* const data, const usize size)
+{
+	StateArchive ar = StateArchive::reader(data, size);
+	serialize(ar);
+}
+
+void Bus::serialize(StateArchive& ar)
+{
+	if (ar.section(StateArchive::tag("ROM "), 1))
+	{
+		u64 hash = cart_->romHash();
+		ar(hash);
+		ar.endSection();
+		if (hash != cart_->romHash())
+		{
+			throw std::runtime_error{ "Save state is for another ROM" };
+		}
+	}
+
+	// the mapper maps pages into memory, the PPU reads through those pages
+	if (ar.section(StateArchive::tag("MEM "), 1))
+	{
+		ar.bytes(&memory_, sizeof(memory_));
+		ar.endSection();
+	}
+	if (ar.section(StateArchive::tag("BUS "), 1))
+	{
+		ar(cpu_time_, ppu_time_, apu_time_, next_event_);
+		ar(dma_transfer, dma_start, dma_addr, oam_addr, joystick, joystick_cache_);
+		ar.endSection();
+	}
+	if (ar.section(StateArchive::tag("MAPR"), 1))
+	{
+		cart_->serialize(ar);
+		ar.endSection();
+	}
+	if (ar.section(StateArchive::tag("CPU "), 1))
+	{
+		cpu.serialize(ar);
+		ar.endSection();
+	}
+	if (ar.section(StateArchive::tag("PPU "), 1))
+	{
+		ppu.serialize(ar);
+		ar.endSection();
+	}
+	if (ar.section(StateArchive::tag("APU "), 1))
+	{
+		apu.serialize(ar);
+		ar.endSection();
+	}
+}
+
 void Bus::insertCartridge(std::unique_ptr<Mapper> cart)
 {
 	cart_ = std::move(cart);
+	// a new cartridge comes with its own, cleared, RAM
+	memory_.prg_ram.fill(0);
+	memory_.chr_ram.fill(0);
+	cart_->attachMemory(memory_);
+	cart_->mapCPUPages(cpu_pages_.data());
+	ppu.insertCartridge();
+	apu.insertCartridge();
+	cpu.flushDecodeCache();
 	reset();
 }
@@ -7,17 +7,34 @@
 #include "APU.hpp"
 #include "Controller/StandardController.hpp"
 #include "Mapper/Mapper.hpp"
+#include "MachineMemory.hpp"
 
 
 class Bus
 {
+	// first, so it exists before the units that keep references into it
+	MachineMemory memory_;
+
 public:
-	static Bus& instance();
+	Bus();
+
+	Bus(const Bus&) = delete;
+	Bus& operator=(const Bus&) = delete;
 
 	void cpuWrite(u16 addr, u8 data);
 	u8 cpuRead(u16 addr);
 
-	void clock();
+	// a sample read by the DMC, which runs behind the CPU, so nothing is caught up
+	u8 dmcRead(u16 addr);
+
+	// the DMC sample at addr as one run of PRG ROM bytes, nullptr if it is
+	// not mapped that way (RAM, a mapper handler or banks out of order)
+	const u8* dmcSampleData(u16 addr, u16 length) const;
+
+	// Runs until the PPU finishes the current frame. The CPU runs ahead and the
+	// PPU and APU are only caught up to it when it touches them, at the next
+	// point where they could raise an interrupt, and at the end of the frame.
+	void runFrame();
 
 	void reset();
 
@@ -29,20 +46,60 @@ public:
 
 	void insertCartridge(std::unique_ptr<Mapper> cart);
 
+	// Writes the state of the whole console to buffer and returns its size.
+	// Nothing is written past size bytes, so a call with size 0 tells how big
+	// the buffer has to be. Does not allocate.
+	usize saveState(u8* buffer, usize size);
+
+	// Throws std::runtime_error if data is not a state of the inserted ROM,
+	// the console is left half loaded if it fails after the header.
+	void loadState(const u8* data, usize size);
+
+	static constexpr std::size_t cpu_mem_size = MachineMemory::ram_size;
+
+	u8* const RAM();
+
+	MachineMemory& memory();
+
+	// How many CPU cycles the CPU may run ahead of the PPU and APU from now on
+	// without missing an interrupt, 0 if it has to stay in lockstep.
+	u32 cpuRunAheadBudget() const;
+
 private:
-	static constexpr std::size_t cpu_mem_size = 2_KB;
+	// where an access goes when its page has no memory pointer
+	enum class PageHandler : u8
+	{
+		None,
+		PPU,       // $2000-$3FFF
+		IO,        // $4000-$43FF: APU, controllers, OAM DMA, then cartridge
+		Cartridge
+	};
 
-	Bus();
+	std::array<CPUPage, CPUPage::count> cpu_pages_{};
+	std::array<PageHandler, CPUPage::count> cpu_page_handlers_{};
 
 	StandardController joystick_cache_;
 
-	std::vector<u8> cpu_mem_;
-
 	std::unique_ptr<Mapper> cart_;
 
+	void cpuCycle();
+	void catchUp(u64 time); // runs the PPU and APU up to and including master cycle time
+	void scheduleEvent();
+	void serialize(StateArchive& ar);
+
+	// Copies the OAM DMA page in one go and skips the CPU past the stall, if
+	// the page is plain memory and the PPU does not read OAM before the DMA
+	// would have ended. The CPU may end up past next_event_.
+	bool oamDMAPage();
+
 	bool dma_transfer = false, dma_start = false;
 	u16 dma_addr = 0;
 	u8 oam_addr = 0;
 
-	u64 cycle_ = 0;
+	// master clock cycles: the next one each unit runs, and the earliest one
+	// at which the PPU or APU may do something the CPU sees on its own
+	u64 cpu_time_ = 0;
+	u64 ppu_time_ = 0;
+	u64 apu_time_ = 0;
+	u64 next_event_ = 0;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "CPU6502.hpp"
 #include "Bus.hpp"
+#include "JIT/JIT6502.hpp"
+#include "StateArchive.hpp"
 
 #ifdef EMUCPULOG
 #include <fstream>
@@ -31,414 +33,414 @@ void CPU6502::print(const int length)
 }
 #endif
 
-CPU6502::CPU6502()
-{
-	const auto unknown = [this]() { unknownOpcode(); };
-	const auto none    = [this]() { this->none(); };
-	const auto imm     = [this]() { this->imm(); };
-	const auto zp      = [this]() { this->zp(); };
-	const auto zpx     = [this]() { this->zpx(); };
-	const auto zpy     = [this]() { this->zpy(); };
-	const auto rel     = [this]() { this->rel(); };
-	const auto ind     = [this]() { this->ind(); };
-	const auto abs     = [this]() { this->abs(); };
-	const auto abx     = [this]() { this->abx(); };
-	const auto aby     = [this]() { this->aby(); };
-	const auto idxInd  = [this]() { this->idxInd(); };
-	const auto indIdx  = [this]() { this->indIdx(); };
-
-	const Instruction unknownInstr = { none, unknown, 0, 0 };
-	instrs_.resize(instrs_size, unknownInstr);
-
-	const auto ADC = [this]() { this->ADC(); };
-	instrs_[0x69] = { imm,    ADC, 2, 0 };
-	instrs_[0x65] = { zp ,    ADC, 3, 0 };
-	instrs_[0x75] = { zpx,    ADC, 4, 0 };
-	instrs_[0x6D] = { abs,    ADC, 4, 0 };
-	instrs_[0x7D] = { abx,    ADC, 4, 1 };
-	instrs_[0x79] = { aby,    ADC, 4, 1 };
-	instrs_[0x61] = { idxInd, ADC, 6, 0 };
-	instrs_[0x71] = { indIdx, ADC, 5, 1 };
-
-	const auto AND = [this]() { this->AND(); };
-	instrs_[0x29] = { imm,    AND, 2, 0 };
-	instrs_[0x25] = { zp ,    AND, 3, 0 };
-	instrs_[0x35] = { zpx,    AND, 4, 0 };
-	instrs_[0x2D] = { abs,    AND, 4, 0 };
-	instrs_[0x3D] = { abx,    AND, 4, 1 };
-	instrs_[0x39] = { aby,    AND, 4, 1 };
-	instrs_[0x21] = { idxInd, AND, 6, 0 };
-	instrs_[0x31] = { indIdx, AND, 5, 1 };
-
-	const auto ASL = [this]() { this->ASL(); };
-	instrs_[0x0A] = { none, ASL, 2, 0 };
-	instrs_[0x06] = { zp  , ASL, 5, 0 };
-	instrs_[0x16] = { zpx , ASL, 6, 0 };
-	instrs_[0x0E] = { abs , ASL, 6, 0 };
-	instrs_[0x1E] = { abx , ASL, 7, 0 };
-
-	const auto BCC = [this]() { this->BCC(); };
-	instrs_[0x90] = { rel, BCC, 2, 1 };
-
-	const auto BCS = [this]() { this->BCS(); };
-	instrs_[0xB0] = { rel, BCS, 2, 1 };
-
-	const auto BEQ = [this]() { this->BEQ(); };
-	instrs_[0xF0] = { rel, BEQ, 2, 1 };
-
-	const auto BIT = [this]() { this->BIT(); };
-	instrs_[0x24] = { zp , BIT, 3, 0 };
-	instrs_[0x2C] = { abs, BIT, 4, 0 };
-
-	const auto BMI = [this]() { this->BMI(); };
-	instrs_[0x30] = { rel, BMI, 2, 1 };
-
-	const auto BNE = [this]() { this->BNE(); };
-	instrs_[0xD0] = { rel, BNE, 2, 1 };
-
-	const auto BPL = [this]() { this->BPL(); };
-	instrs_[0x10] = { rel, BPL, 2, 1 };
-
-	const auto BRK = [this]() { this->BRK(); };
-	instrs_[0x00] = { none, BRK, 7, 0 };
-
-	const auto BVC = [this]() { this->BVC(); };
-	instrs_[0x50] = { rel, BVC, 2, 1 };
-
-	const auto BVS = [this]() { this->BVS(); };
-	instrs_[0x70] = { rel, BVS, 2, 1 };
-
-	const auto CLC = [this]() { this->CLC(); };
-	instrs_[0x18] = { none, CLC, 2, 0 };
-
-	const auto CLD = [this]() { this->CLD(); };
-	instrs_[0xD8] = { none, CLD, 2, 0 };
-
-	const auto CLI = [this]() { this->CLI(); };
-	instrs_[0x58] = { none, CLI, 2, 0 };
-
-	const auto CLV = [this]() { this->CLV(); };
-	instrs_[0xB8] = { none, CLV, 2, 0 };
-
-	const auto CMP = [this]() { this->CMP(); };
-	instrs_[0xC9] = { imm   , CMP, 2, 0 };
-	instrs_[0xC5] = { zp    , CMP, 3, 0 };
-	instrs_[0xD5] = { zpx   , CMP, 4, 0 };
-	instrs_[0xCD] = { abs   , CMP, 4, 0 };
-	instrs_[0xDD] = { abx   , CMP, 4, 1 };
-	instrs_[0xD9] = { aby   , CMP, 4, 1 };
-	instrs_[0xC1] = { idxInd, CMP, 6, 0 };
-	instrs_[0xD1] = { indIdx, CMP, 5, 1 };
-
-	const auto CPX = [this]() { this->CPX(); };
-	instrs_[0xE0] = { imm, CPX, 2, 0 };
-	instrs_[0xE4] = { zp , CPX, 3, 0 };
-	instrs_[0xEC] = { abs, CPX, 4, 0 };
-
-	const auto CPY = [this]() { this->CPY(); };
-	instrs_[0xC0] = { imm, CPY, 2, 0 }; 
-	instrs_[0xC4] = { zp , CPY, 3, 0 }; 
-	instrs_[0xCC] = { abs, CPY, 4, 0 };
-
-	const auto DEC = [this]() { this->DEC(); };
-	instrs_[0xC6] = { zp , DEC, 5, 0 };
-	instrs_[0xD6] = { zpx, DEC, 6, 0 };
-	instrs_[0xCE] = { abs, DEC, 6, 0 };
-	instrs_[0xDE] = { abx, DEC, 7, 0 };
-
-	const auto DEX = [this]() { this->DEX(); };
-	instrs_[0xCA] = { none, DEX, 2, 0 };
-
-	const auto DEY = [this]() { this->DEY(); };
-	instrs_[0x88] = { none, DEY, 2, 0 };
+template<CPU6502::AddrMode mode, CPU6502::Operation operate>
+void CPU6502::execute()
+{
+	switch (mode)
+	{
+	case AddrMode::Imp:    none();   break;
+	case AddrMode::Imm:    imm();    break;
+	case AddrMode::ZP:     zp();     break;
+	case AddrMode::ZPX:    zpx();    break;
+	case AddrMode::ZPY:    zpy();    break;
+	case AddrMode::Rel:    rel();    break;
+	case AddrMode::Abs:    abs();    break;
+	case AddrMode::Abx:    abx();    break;
+	case AddrMode::Aby:    aby();    break;
+	case AddrMode::Ind:    ind();    break;
+	case AddrMode::IdxInd: idxInd(); break;
+	case AddrMode::IndIdx: indIdx(); break;
+	}
+
+#ifdef EMUCPULOG
+	print(reg_.PC - log_regs.PC);
+#endif
+
+	(this->*operate)();
+}
+
+template<CPU6502::AddrMode mode, CPU6502::Operation operate>
+constexpr CPU6502::Instruction CPU6502::instr(const u8 cycles, const u8 penalty)
+{
+	u8 length = 1;
+	switch (mode)
+	{
+	case AddrMode::Imm: case AddrMode::ZP: case AddrMode::ZPX: case AddrMode::ZPY:
+	case AddrMode::Rel: case AddrMode::IdxInd: case AddrMode::IndIdx:
+		length = 2;
+		break;
+
+	case AddrMode::Abs: case AddrMode::Abx: case AddrMode::Aby: case AddrMode::Ind:
+		length = 3;
+		break;
+
+	default:
+		break;
+	}
+	return { &CPU6502::execute<mode, operate>, { cycles, penalty }, length };
+}
+
+constexpr std::array<CPU6502::Instruction, CPU6502::instrs_size> CPU6502::makeInstructionTable()
+{
+	using M = AddrMode;
+
+	std::array<Instruction, instrs_size> table{};
+	for (auto& entry : table)
+		entry = instr<M::Imp, &CPU6502::unknownOpcode>(0, 0);
+
+	table[0x69] = instr<M::Imm,    &CPU6502::ADC>(2, 0);
+	table[0x65] = instr<M::ZP,     &CPU6502::ADC>(3, 0);
+	table[0x75] = instr<M::ZPX,    &CPU6502::ADC>(4, 0);
+	table[0x6D] = instr<M::Abs,    &CPU6502::ADC>(4, 0);
+	table[0x7D] = instr<M::Abx,    &CPU6502::ADC>(4, 1);
+	table[0x79] = instr<M::Aby,    &CPU6502::ADC>(4, 1);
+	table[0x61] = instr<M::IdxInd, &CPU6502::ADC>(6, 0);
+	table[0x71] = instr<M::IndIdx, &CPU6502::ADC>(5, 1);
+
+	table[0x29] = instr<M::Imm,    &CPU6502::AND>(2, 0);
+	table[0x25] = instr<M::ZP,     &CPU6502::AND>(3, 0);
+	table[0x35] = instr<M::ZPX,    &CPU6502::AND>(4, 0);
+	table[0x2D] = instr<M::Abs,    &CPU6502::AND>(4, 0);
+	table[0x3D] = instr<M::Abx,    &CPU6502::AND>(4, 1);
+	table[0x39] = instr<M::Aby,    &CPU6502::AND>(4, 1);
+	table[0x21] = instr<M::IdxInd, &CPU6502::AND>(6, 0);
+	table[0x31] = instr<M::IndIdx, &CPU6502::AND>(5, 1);
+
+	table[0x0A] = instr<M::Imp, &CPU6502::ASL>(2, 0);
+	table[0x06] = instr<M::ZP,  &CPU6502::ASL>(5, 0);
+	table[0x16] = instr<M::ZPX, &CPU6502::ASL>(6, 0);
+	table[0x0E] = instr<M::Abs, &CPU6502::ASL>(6, 0);
+	table[0x1E] = instr<M::Abx, &CPU6502::ASL>(7, 0);
+
+	table[0x90] = instr<M::Rel, &CPU6502::BCC>(2, 1);
+
+	table[0xB0] = instr<M::Rel, &CPU6502::BCS>(2, 1);
+
+	table[0xF0] = instr<M::Rel, &CPU6502::BEQ>(2, 1);
+
+	table[0x24] = instr<M::ZP,  &CPU6502::BIT>(3, 0);
+	table[0x2C] = instr<M::Abs, &CPU6502::BIT>(4, 0);
+
+	table[0x30] = instr<M::Rel, &CPU6502::BMI>(2, 1);
+
+	table[0xD0] = instr<M::Rel, &CPU6502::BNE>(2, 1);
+
+	table[0x10] = instr<M::Rel, &CPU6502::BPL>(2, 1);
+
+	table[0x00] = instr<M::Imp, &CPU6502::BRK>(7, 0);
+
+	table[0x50] = instr<M::Rel, &CPU6502::BVC>(2, 1);
+
+	table[0x70] = instr<M::Rel, &CPU6502::BVS>(2, 1);
+
+	table[0x18] = instr<M::Imp, &CPU6502::CLC>(2, 0);
+
+	table[0xD8] = instr<M::Imp, &CPU6502::CLD>(2, 0);
+
+	table[0x58] = instr<M::Imp, &CPU6502::CLI>(2, 0);
+
+	table[0xB8] = instr<M::Imp, &CPU6502::CLV>(2, 0);
+
+	table[0xC9] = instr<M::Imm,    &CPU6502::CMP>(2, 0);
+	table[0xC5] = instr<M::ZP,     &CPU6502::CMP>(3, 0);
+	table[0xD5] = instr<M::ZPX,    &CPU6502::CMP>(4, 0);
+	table[0xCD] = instr<M::Abs,    &CPU6502::CMP>(4, 0);
+	table[0xDD] = instr<M::Abx,    &CPU6502::CMP>(4, 1);
+	table[0xD9] = instr<M::Aby,    &CPU6502::CMP>(4, 1);
+	table[0xC1] = instr<M::IdxInd, &CPU6502::CMP>(6, 0);
+	table[0xD1] = instr<M::IndIdx, &CPU6502::CMP>(5, 1);
+
+	table[0xE0] = instr<M::Imm, &CPU6502::CPX>(2, 0);
+	table[0xE4] = instr<M::ZP,  &CPU6502::CPX>(3, 0);
+	table[0xEC] = instr<M::Abs, &CPU6502::CPX>(4, 0);
+
+	table[0xC0] = instr<M::Imm, &CPU6502::CPY>(2, 0);
+	table[0xC4] = instr<M::ZP,  &CPU6502::CPY>(3, 0);
+	table[0xCC] = instr<M::Abs, &CPU6502::CPY>(4, 0);
+
+	table[0xC6] = instr<M::ZP,  &CPU6502::DEC>(5, 0);
+	table[0xD6] = instr<M::ZPX, &CPU6502::DEC>(6, 0);
+	table[0xCE] = instr<M::Abs, &CPU6502::DEC>(6, 0);
+	table[0xDE] = instr<M::Abx, &CPU6502::DEC>(7, 0);
+
+	table[0xCA] = instr<M::Imp, &CPU6502::DEX>(2, 0);
+
+	table[0x88] = instr<M::Imp, &CPU6502::DEY>(2, 0);
 	
-	const auto EOR = [this]() { this->EOR(); };
-	instrs_[0x49] = { imm   , EOR, 2, 0 };
-	instrs_[0x45] = { zp    , EOR, 3, 0 };
-	instrs_[0x55] = { zpx   , EOR, 4, 0 };
-	instrs_[0x4D] = { abs   , EOR, 4, 0 };
-	instrs_[0x5D] = { abx   , EOR, 4, 1 };
-	instrs_[0x59] = { aby   , EOR, 4, 1 };
-	instrs_[0x41] = { idxInd, EOR, 6, 0 };
-	instrs_[0x51] = { indIdx, EOR, 5, 1 };
-
-	const auto INC = [this]() { this->INC(); };
-	instrs_[0xE6] = { zp , INC, 5, 0 };
-	instrs_[0xF6] = { zpx, INC, 6, 0 };
-	instrs_[0xEE] = { abs, INC, 6, 0 };
-	instrs_[0xFE] = { abx, INC, 7, 0 };
-
-	const auto INX = [this]() { this->INX(); };
-	instrs_[0xE8] = { none, INX, 2, 0 };
-
-	const auto INY = [this]() { this->INY(); };
-	instrs_[0xC8] = { none, INY, 2, 0 };
-
-	const auto JMP = [this]() { this->JMP(); };
-	instrs_[0x4C] = { abs, JMP, 3, 0 };
-	instrs_[0x6C] = { ind, JMP, 5, 0 };
-
-	const auto JSR = [this]() { this->JSR(); };
-	instrs_[0x20] = { abs, JSR, 6, 0 };
-
-	const auto LDA = [this]() { this->LDA(); };
-	instrs_[0xA9] = { imm   , LDA, 2, 0 }; 
-	instrs_[0xA5] = { zp    , LDA, 3, 0 }; 
-	instrs_[0xB5] = { zpx   , LDA, 4, 0 }; 
-	instrs_[0xAD] = { abs   , LDA, 4, 0 };
-	instrs_[0xBD] = { abx   , LDA, 4, 1 }; 
-	instrs_[0xB9] = { aby   , LDA, 4, 1 }; 
-	instrs_[0xA1] = { idxInd, LDA, 6, 0 }; 
-	instrs_[0xB1] = { indIdx, LDA, 5, 1 };;
-
-	const auto LDX = [this]() { this->LDX(); };
-	instrs_[0xA2] = { imm, LDX, 2, 0 }; 
-	instrs_[0xA6] = { zp , LDX, 3, 0 }; 
-	instrs_[0xB6] = { zpy, LDX, 4, 0 }; 
-	instrs_[0xAE] = { abs, LDX, 4, 0 };
-	instrs_[0xBE] = { aby, LDX, 4, 1 };
-
-	const auto LDY = [this]() { this->LDY(); };
-	instrs_[0xA0] = { imm, LDY, 2, 0 }; 
-	instrs_[0xA4] = { zp , LDY, 3, 0 }; 
-	instrs_[0xB4] = { zpx, LDY, 4, 0 }; 
-	instrs_[0xAC] = { abs, LDY, 4, 0 };
-	instrs_[0xBC] = { abx, LDY, 4, 1 };
-
-	const auto LSR = [this]() { this->LSR(); };
-	instrs_[0x4A] = { none, LSR, 2, 0 }; 
-	instrs_[0x46] = { zp  , LSR, 5, 0 };
-	instrs_[0x56] = { zpx , LSR, 6, 0 }; 
-	instrs_[0x4E] = { abs , LSR, 6, 0 }; 
-	instrs_[0x5E] = { abx , LSR, 7, 0 };
-
-	const auto NOP = [this]() { this->NOP(); };
-	instrs_[0xEA] = { none , NOP, 2, 0 };
-
-	const auto ORA = [this]() { this->ORA(); };
-	instrs_[0x09] = { imm   , ORA, 2, 0 }; 
-	instrs_[0x05] = { zp    , ORA, 3, 0 }; 
-	instrs_[0x15] = { zpx   , ORA, 4, 0 }; 
-	instrs_[0x0D] = { abs   , ORA, 4, 0 };
-	instrs_[0x1D] = { abx   , ORA, 4, 1 }; 
-	instrs_[0x19] = { aby   , ORA, 4, 1 }; 
-	instrs_[0x01] = { idxInd, ORA, 6, 0 }; 
-	instrs_[0x11] = { indIdx, ORA, 5, 1 };
-
-	const auto PHA = [this]() { this->PHA(); };
-	instrs_[0x48] = { none, PHA, 3, 0 };
-
-	const auto PHP = [this]() { this->PHP(); };
-	instrs_[0x08] = { none, PHP, 3, 0 };
-
-	const auto PLA = [this]() { this->PLA(); };
-	instrs_[0x68] = { none, PLA, 4, 0 };
-
-	const auto PLP = [this]() { this->PLP(); };
-	instrs_[0x28] = { none, PLP, 4, 0 };
-
-	const auto ROL = [this]() { this->ROL(); };
-	instrs_[0x2A] = { none, ROL, 2, 0 }; 
-	instrs_[0x26] = { zp  , ROL, 5, 0 };
-	instrs_[0x36] = { zpx , ROL, 6, 0 }; 
-	instrs_[0x2E] = { abs , ROL, 6, 0 }; 
-	instrs_[0x3E] = { abx , ROL, 7, 0 };
-
-	const auto ROR = [this]() { this->ROR(); };
-	instrs_[0x6A] = { none, ROR, 2, 0 }; 
-	instrs_[0x66] = { zp  , ROR, 5, 0 };
-	instrs_[0x76] = { zpx , ROR, 6, 0 }; 
-	instrs_[0x6E] = { abs , ROR, 6, 0 }; 
-	instrs_[0x7E] = { abx , ROR, 7, 0 };
-
-	const auto RTI = [this]() { this->RTI(); };
-	instrs_[0x40] = { none, RTI, 6, 0 };
-
-	const auto RTS = [this]() { this->RTS(); };
-	instrs_[0x60] = { none, RTS, 6, 0 };
-
-	const auto SBC = [this]() { this->SBC(); };
-	instrs_[0xE9] = { imm   , SBC, 2, 0 }; 
-	instrs_[0xE5] = { zp    , SBC, 3, 0 }; 
-	instrs_[0xF5] = { zpx   , SBC, 4, 0 }; 
-	instrs_[0xED] = { abs   , SBC, 4, 0 };
-	instrs_[0xFD] = { abx   , SBC, 4, 1 }; 
-	instrs_[0xF9] = { aby   , SBC, 4, 1 }; 
-	instrs_[0xE1] = { idxInd, SBC, 6, 0 }; 
-	instrs_[0xF1] = { indIdx, SBC, 5, 1 };
-
-	const auto SEC = [this]() { this->SEC(); };
-	instrs_[0x38] = { none, SEC, 2, 0 };
-
-	const auto SED = [this]() { this->SED(); };
-	instrs_[0xF8] = { none, SED, 2, 0 };
-
-	const auto SEI = [this]() { this->SEI(); };
-	instrs_[0x78] = { none, SEI, 2, 0 };
-
-	const auto STA = [this]() { this->STA(); };
-	instrs_[0x85] = { zp    , STA, 3, 0 }; 
-	instrs_[0x95] = { zpx   , STA, 4, 0 }; 
-	instrs_[0x8D] = { abs   , STA, 4, 0 };
-	instrs_[0x9D] = { abx   , STA, 5, 0 }; 
-	instrs_[0x99] = { aby   , STA, 5, 0 }; 
-	instrs_[0x81] = { idxInd, STA, 6, 0 }; 
-	instrs_[0x91] = { indIdx, STA, 6, 0 };
-
-	const auto STX = [this]() { this->STX(); };
-	instrs_[0x86] = { zp , STX, 3, 0 };
-	instrs_[0x96] = { zpy, STX, 4, 0 }; 
-	instrs_[0x8E] = { abs, STX, 4, 0 };
-
-	const auto STY = [this]() { this->STY(); };
-	instrs_[0x84] = { zp , STY, 3, 0 }; 
-	instrs_[0x94] = { zpx, STY, 4, 0 }; 
-	instrs_[0x8C] = { abs, STY, 4, 0 };
-
-	const auto TAX = [this]() { this->TAX(); };
-	instrs_[0xAA] = { none, TAX, 2, 0 };
-
-	const auto TAY = [this]() { this->TAY(); };
-	instrs_[0xA8] = { none, TAY, 2, 0 };
-
-	const auto TSX = [this]() { this->TSX(); };
-	instrs_[0xBA] = { none, TSX, 2, 0 };
-
-	const auto TXA = [this]() { this->TXA(); };
-	instrs_[0x8A] = { none, TXA, 2, 0 };
-
-	const auto TXS = [this]() { this->TXS(); };
-	instrs_[0x9A] = { none, TXS, 2, 0 };
-
-	const auto TYA = [this]() { this->TYA(); };
-	instrs_[0x98] = { none, TYA, 2, 0 };
+	table[0x49] = instr<M::Imm,    &CPU6502::EOR>(2, 0);
+	table[0x45] = instr<M::ZP,     &CPU6502::EOR>(3, 0);
+	table[0x55] = instr<M::ZPX,    &CPU6502::EOR>(4, 0);
+	table[0x4D] = instr<M::Abs,    &CPU6502::EOR>(4, 0);
+	table[0x5D] = instr<M::Abx,    &CPU6502::EOR>(4, 1);
+	table[0x59] = instr<M::Aby,    &CPU6502::EOR>(4, 1);
+	table[0x41] = instr<M::IdxInd, &CPU6502::EOR>(6, 0);
+	table[0x51] = instr<M::IndIdx, &CPU6502::EOR>(5, 1);
+
+	table[0xE6] = instr<M::ZP,  &CPU6502::INC>(5, 0);
+	table[0xF6] = instr<M::ZPX, &CPU6502::INC>(6, 0);
+	table[0xEE] = instr<M::Abs, &CPU6502::INC>(6, 0);
+	table[0xFE] = instr<M::Abx, &CPU6502::INC>(7, 0);
+
+	table[0xE8] = instr<M::Imp, &CPU6502::INX>(2, 0);
+
+	table[0xC8] = instr<M::Imp, &CPU6502::INY>(2, 0);
+
+	table[0x4C] = instr<M::Abs, &CPU6502::JMP>(3, 0);
+	table[0x6C] = instr<M::Ind, &CPU6502::JMP>(5, 0);
+
+	table[0x20] = instr<M::Abs, &CPU6502::JSR>(6, 0);
+
+	table[0xA9] = instr<M::Imm,    &CPU6502::LDA>(2, 0);
+	table[0xA5] = instr<M::ZP,     &CPU6502::LDA>(3, 0);
+	table[0xB5] = instr<M::ZPX,    &CPU6502::LDA>(4, 0);
+	table[0xAD] = instr<M::Abs,    &CPU6502::LDA>(4, 0);
+	table[0xBD] = instr<M::Abx,    &CPU6502::LDA>(4, 1);
+	table[0xB9] = instr<M::Aby,    &CPU6502::LDA>(4, 1);
+	table[0xA1] = instr<M::IdxInd, &CPU6502::LDA>(6, 0);
+	table[0xB1] = instr<M::IndIdx, &CPU6502::LDA>(5, 1);
+
+	table[0xA2] = instr<M::Imm, &CPU6502::LDX>(2, 0);
+	table[0xA6] = instr<M::ZP,  &CPU6502::LDX>(3, 0);
+	table[0xB6] = instr<M::ZPY, &CPU6502::LDX>(4, 0);
+	table[0xAE] = instr<M::Abs, &CPU6502::LDX>(4, 0);
+	table[0xBE] = instr<M::Aby, &CPU6502::LDX>(4, 1);
+
+	table[0xA0] = instr<M::Imm, &CPU6502::LDY>(2, 0);
+	table[0xA4] = instr<M::ZP,  &CPU6502::LDY>(3, 0);
+	table[0xB4] = instr<M::ZPX, &CPU6502::LDY>(4, 0);
+	table[0xAC] = instr<M::Abs, &CPU6502::LDY>(4, 0);
+	table[0xBC] = instr<M::Abx, &CPU6502::LDY>(4, 1);
+
+	table[0x4A] = instr<M::Imp, &CPU6502::LSR>(2, 0);
+	table[0x46] = instr<M::ZP,  &CPU6502::LSR>(5, 0);
+	table[0x56] = instr<M::ZPX, &CPU6502::LSR>(6, 0);
+	table[0x4E] = instr<M::Abs, &CPU6502::LSR>(6, 0);
+	table[0x5E] = instr<M::Abx, &CPU6502::LSR>(7, 0);
+
+	table[0xEA] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+
+	table[0x09] = instr<M::Imm,    &CPU6502::ORA>(2, 0);
+	table[0x05] = instr<M::ZP,     &CPU6502::ORA>(3, 0);
+	table[0x15] = instr<M::ZPX,    &CPU6502::ORA>(4, 0);
+	table[0x0D] = instr<M::Abs,    &CPU6502::ORA>(4, 0);
+	table[0x1D] = instr<M::Abx,    &CPU6502::ORA>(4, 1);
+	table[0x19] = instr<M::Aby,    &CPU6502::ORA>(4, 1);
+	table[0x01] = instr<M::IdxInd, &CPU6502::ORA>(6, 0);
+	table[0x11] = instr<M::IndIdx, &CPU6502::ORA>(5, 1);
+
+	table[0x48] = instr<M::Imp, &CPU6502::PHA>(3, 0);
+
+	table[0x08] = instr<M::Imp, &CPU6502::PHP>(3, 0);
+
+	table[0x68] = instr<M::Imp, &CPU6502::PLA>(4, 0);
+
+	table[0x28] = instr<M::Imp, &CPU6502::PLP>(4, 0);
+
+	table[0x2A] = instr<M::Imp, &CPU6502::ROL>(2, 0);
+	table[0x26] = instr<M::ZP,  &CPU6502::ROL>(5, 0);
+	table[0x36] = instr<M::ZPX, &CPU6502::ROL>(6, 0);
+	table[0x2E] = instr<M::Abs, &CPU6502::ROL>(6, 0);
+	table[0x3E] = instr<M::Abx, &CPU6502::ROL>(7, 0);
+
+	table[0x6A] = instr<M::Imp, &CPU6502::ROR>(2, 0);
+	table[0x66] = instr<M::ZP,  &CPU6502::ROR>(5, 0);
+	table[0x76] = instr<M::ZPX, &CPU6502::ROR>(6, 0);
+	table[0x6E] = instr<M::Abs, &CPU6502::ROR>(6, 0);
+	table[0x7E] = instr<M::Abx, &CPU6502::ROR>(7, 0);
+
+	table[0x40] = instr<M::Imp, &CPU6502::RTI>(6, 0);
+
+	table[0x60] = instr<M::Imp, &CPU6502::RTS>(6, 0);
+
+	table[0xE9] = instr<M::Imm,    &CPU6502::SBC>(2, 0);
+	table[0xE5] = instr<M::ZP,     &CPU6502::SBC>(3, 0);
+	table[0xF5] = instr<M::ZPX,    &CPU6502::SBC>(4, 0);
+	table[0xED] = instr<M::Abs,    &CPU6502::SBC>(4, 0);
+	table[0xFD] = instr<M::Abx,    &CPU6502::SBC>(4, 1);
+	table[0xF9] = instr<M::Aby,    &CPU6502::SBC>(4, 1);
+	table[0xE1] = instr<M::IdxInd, &CPU6502::SBC>(6, 0);
+	table[0xF1] = instr<M::IndIdx, &CPU6502::SBC>(5, 1);
+
+	table[0x38] = instr<M::Imp, &CPU6502::SEC>(2, 0);
+
+	table[0xF8] = instr<M::Imp, &CPU6502::SED>(2, 0);
+
+	table[0x78] = instr<M::Imp, &CPU6502::SEI>(2, 0);
+
+	table[0x85] = instr<M::ZP,     &CPU6502::STA>(3, 0);
+	table[0x95] = instr<M::ZPX,    &CPU6502::STA>(4, 0);
+	table[0x8D] = instr<M::Abs,    &CPU6502::STA>(4, 0);
+	table[0x9D] = instr<M::Abx,    &CPU6502::STA>(5, 0);
+	table[0x99] = instr<M::Aby,    &CPU6502::STA>(5, 0);
+	table[0x81] = instr<M::IdxInd, &CPU6502::STA>(6, 0);
+	table[0x91] = instr<M::IndIdx, &CPU6502::STA>(6, 0);
+
+	table[0x86] = instr<M::ZP,  &CPU6502::STX>(3, 0);
+	table[0x96] = instr<M::ZPY, &CPU6502::STX>(4, 0);
+	table[0x8E] = instr<M::Abs, &CPU6502::STX>(4, 0);
+
+	table[0x84] = instr<M::ZP,  &CPU6502::STY>(3, 0);
+	table[0x94] = instr<M::ZPX, &CPU6502::STY>(4, 0);
+	table[0x8C] = instr<M::Abs, &CPU6502::STY>(4, 0);
+
+	table[0xAA] = instr<M::Imp, &CPU6502::TAX>(2, 0);
+
+	table[0xA8] = instr<M::Imp, &CPU6502::TAY>(2, 0);
+
+	table[0xBA] = instr<M::Imp, &CPU6502::TSX>(2, 0);
+
+	table[0x8A] = instr<M::Imp, &CPU6502::TXA>(2, 0);
+
+	table[0x9A] = instr<M::Imp, &CPU6502::TXS>(2, 0);
+
+	table[0x98] = instr<M::Imp, &CPU6502::TYA>(2, 0);
 
 	// unofficial instructions
 	/*
-	const auto ALR = [this]() { this->ALR(); };
-	instrs_[0x4B] = { imm, ALR, 2, 0 };
-
-	const auto ANC = [this]() { this->ANC(); };
-	instrs_[0x0B] = { imm, ANC, 2, 0 };
-	instrs_[0x2B] = { imm, ANC, 2, 0 };
-
-	const auto ARR = [this] { this->ARR(); };
-	instrs_[0x6B] = { imm, ARR, 2, 0 };
-
-	const auto LAX = [this]() { this->LAX(); };
-	instrs_[0xAB] = { imm   , LAX, 2, 0 };
-	instrs_[0xA7] = { zp    , LAX, 3, 0 };
-	instrs_[0xB7] = { zpy   , LAX, 4, 0 };
-	instrs_[0xAF] = { abs   , LAX, 4, 0 };
-	instrs_[0xBF] = { aby   , LAX, 4, 1 };
-	instrs_[0xA3] = { idxInd, LAX, 6, 0 };
-	instrs_[0xB3] = { indIdx, LAX, 5, 1 };
-
-	const auto SAX = [this]() { this->SAX(); };
-	instrs_[0x87] = { zp    , SAX, 3, 0 };
-	instrs_[0x97] = { zpy   , SAX, 4, 0 };
-	instrs_[0x8F] = { abs   , SAX, 4, 0 };
-	instrs_[0x83] = { idxInd, SAX, 6, 0 };
-
-	const auto DCP = [this]() { this->DCP(); };
-	instrs_[0xC7] = { zp    , DCP, 5, 0 };
-	instrs_[0xD7] = { zpx   , DCP, 6, 0 };
-	instrs_[0xCF] = { abs   , DCP, 6, 0 };
-	instrs_[0xDF] = { abx   , DCP, 7, 0 };
-	instrs_[0xDB] = { aby   , DCP, 7, 0 };
-	instrs_[0xC3] = { idxInd, DCP, 8, 0 };
-	instrs_[0xD3] = { indIdx, DCP, 8, 0 };
-
-	const auto ISC = [this]() { this->ISC(); };
-	instrs_[0xE7] = { zp    , ISC, 5, 0 };
-	instrs_[0xF7] = { zpx   , ISC, 6, 0 };
-	instrs_[0xEF] = { abs   , ISC, 6, 0 };
-	instrs_[0xFF] = { abx   , ISC, 7, 0 };
-	instrs_[0xFB] = { aby   , ISC, 7, 0 };
-	instrs_[0xE3] = { idxInd, ISC, 8, 0 };
-	instrs_[0xF3] = { indIdx, ISC, 8, 0 };
-
-	const auto RLA = [this]() { this->RLA(); };
-	instrs_[0x27] = { zp    , RLA, 5, 0 };
-	instrs_[0x37] = { zpx   , RLA, 6, 0 };
-	instrs_[0x2F] = { abs   , RLA, 6, 0 };
-	instrs_[0x3F] = { abx   , RLA, 7, 0 };
-	instrs_[0x3B] = { aby   , RLA, 7, 0 };
-	instrs_[0x23] = { idxInd, RLA, 8, 0 };
-	instrs_[0x33] = { indIdx, RLA, 8, 0 };
-
-	const auto RRA = [this]() { this->RRA(); };
-	instrs_[0x67] = { zp    , RRA, 5, 0 };
-	instrs_[0x77] = { zpx   , RRA, 6, 0 };
-	instrs_[0x6F] = { abs   , RRA, 6, 0 };
-	instrs_[0x7F] = { abx   , RRA, 7, 0 };
-	instrs_[0x7B] = { aby   , RRA, 7, 0 };
-	instrs_[0x63] = { idxInd, RRA, 8, 0 };
-	instrs_[0x73] = { indIdx, RRA, 8, 0 };
-
-	const auto SLO = [this]() { this->SLO(); };
-	instrs_[0x07] = { zp    , SLO, 5, 0 };
-	instrs_[0x17] = { zpx   , SLO, 6, 0 };
-	instrs_[0x0F] = { abs   , SLO, 6, 0 };
-	instrs_[0x1F] = { abx   , SLO, 7, 0 };
-	instrs_[0x1B] = { aby   , SLO, 7, 0 };
-	instrs_[0x03] = { idxInd, SLO, 8, 0 };
-	instrs_[0x13] = { indIdx, SLO, 8, 0 };
-
-	const auto SRE = [this]() { this->SRE(); };
-	instrs_[0x47] = { zp    , SRE, 5, 0 };
-	instrs_[0x57] = { zpx   , SRE, 6, 0 };
-	instrs_[0x4F] = { abs   , SRE, 6, 0 };
-	instrs_[0x5F] = { abx   , SRE, 7, 0 };
-	instrs_[0x5B] = { aby   , SRE, 7, 0 };
-	instrs_[0x43] = { idxInd, SRE, 8, 0 };
-	instrs_[0x53] = { indIdx, SRE, 8, 0 };
+	table[0x4B] = instr<M::Imm, &CPU6502::ALR>(2, 0);
+
+	table[0x0B] = instr<M::Imm, &CPU6502::ANC>(2, 0);
+	table[0x2B] = instr<M::Imm, &CPU6502::ANC>(2, 0);
+
+	table[0x6B] = instr<M::Imm, &CPU6502::ARR>(2, 0);
+
+	table[0xAB] = instr<M::Imm,    &CPU6502::LAX>(2, 0);
+	table[0xA7] = instr<M::ZP,     &CPU6502::LAX>(3, 0);
+	table[0xB7] = instr<M::ZPY,    &CPU6502::LAX>(4, 0);
+	table[0xAF] = instr<M::Abs,    &CPU6502::LAX>(4, 0);
+	table[0xBF] = instr<M::Aby,    &CPU6502::LAX>(4, 1);
+	table[0xA3] = instr<M::IdxInd, &CPU6502::LAX>(6, 0);
+	table[0xB3] = instr<M::IndIdx, &CPU6502::LAX>(5, 1);
+
+	table[0x87] = instr<M::ZP,     &CPU6502::SAX>(3, 0);
+	table[0x97] = instr<M::ZPY,    &CPU6502::SAX>(4, 0);
+	table[0x8F] = instr<M::Abs,    &CPU6502::SAX>(4, 0);
+	table[0x83] = instr<M::IdxInd, &CPU6502::SAX>(6, 0);
+
+	table[0xC7] = instr<M::ZP,     &CPU6502::DCP>(5, 0);
+	table[0xD7] = instr<M::ZPX,    &CPU6502::DCP>(6, 0);
+	table[0xCF] = instr<M::Abs,    &CPU6502::DCP>(6, 0);
+	table[0xDF] = instr<M::Abx,    &CPU6502::DCP>(7, 0);
+	table[0xDB] = instr<M::Aby,    &CPU6502::DCP>(7, 0);
+	table[0xC3] = instr<M::IdxInd, &CPU6502::DCP>(8, 0);
+	table[0xD3] = instr<M::IndIdx, &CPU6502::DCP>(8, 0);
+
+	table[0xE7] = instr<M::ZP,     &CPU6502::ISC>(5, 0);
+	table[0xF7] = instr<M::ZPX,    &CPU6502::ISC>(6, 0);
+	table[0xEF] = instr<M::Abs,    &CPU6502::ISC>(6, 0);
+	table[0xFF] = instr<M::Abx,    &CPU6502::ISC>(7, 0);
+	table[0xFB] = instr<M::Aby,    &CPU6502::ISC>(7, 0);
+	table[0xE3] = instr<M::IdxInd, &CPU6502::ISC>(8, 0);
+	table[0xF3] = instr<M::IndIdx, &CPU6502::ISC>(8, 0);
+
+	table[0x27] = instr<M::ZP,     &CPU6502::RLA>(5, 0);
+	table[0x37] = instr<M::ZPX,    &CPU6502::RLA>(6, 0);
+	table[0x2F] = instr<M::Abs,    &CPU6502::RLA>(6, 0);
+	table[0x3F] = instr<M::Abx,    &CPU6502::RLA>(7, 0);
+	table[0x3B] = instr<M::Aby,    &CPU6502::RLA>(7, 0);
+	table[0x23] = instr<M::IdxInd, &CPU6502::RLA>(8, 0);
+	table[0x33] = instr<M::IndIdx, &CPU6502::RLA>(8, 0);
+
+	table[0x67] = instr<M::ZP,     &CPU6502::RRA>(5, 0);
+	table[0x77] = instr<M::ZPX,    &CPU6502::RRA>(6, 0);
+	table[0x6F] = instr<M::Abs,    &CPU6502::RRA>(6, 0);
+	table[0x7F] = instr<M::Abx,    &CPU6502::RRA>(7, 0);
+	table[0x7B] = instr<M::Aby,    &CPU6502::RRA>(7, 0);
+	table[0x63] = instr<M::IdxInd, &CPU6502::RRA>(8, 0);
+	table[0x73] = instr<M::IndIdx, &CPU6502::RRA>(8, 0);
+
+	table[0x07] = instr<M::ZP,     &CPU6502::SLO>(5, 0);
+	table[0x17] = instr<M::ZPX,    &CPU6502::SLO>(6, 0);
+	table[0x0F] = instr<M::Abs,    &CPU6502::SLO>(6, 0);
+	table[0x1F] = instr<M::Abx,    &CPU6502::SLO>(7, 0);
+	table[0x1B] = instr<M::Aby,    &CPU6502::SLO>(7, 0);
+	table[0x03] = instr<M::IdxInd, &CPU6502::SLO>(8, 0);
+	table[0x13] = instr<M::IndIdx, &CPU6502::SLO>(8, 0);
+
+	table[0x47] = instr<M::ZP,     &CPU6502::SRE>(5, 0);
+	table[0x57] = instr<M::ZPX,    &CPU6502::SRE>(6, 0);
+	table[0x4F] = instr<M::Abs,    &CPU6502::SRE>(6, 0);
+	table[0x5F] = instr<M::Abx,    &CPU6502::SRE>(7, 0);
+	table[0x5B] = instr<M::Aby,    &CPU6502::SRE>(7, 0);
+	table[0x43] = instr<M::IdxInd, &CPU6502::SRE>(8, 0);
+	table[0x53] = instr<M::IndIdx, &CPU6502::SRE>(8, 0);
 
 	// USBC or *SBC
-	instrs_[0xEB] = { imm, SBC, 2, 0 };
+	table[0xEB] = instr<M::Imm, &CPU6502::SBC>(2, 0);
 
 	// NOPs
-	instrs_[0x1A] = { none, NOP, 2, 0 };
-	instrs_[0x3A] = { none, NOP, 2, 0 };
-	instrs_[0x5A] = { none, NOP, 2, 0 };
-	instrs_[0x7A] = { none, NOP, 2, 0 };
-	instrs_[0xDA] = { none, NOP, 2, 0 };
-	instrs_[0xFA] = { none, NOP, 2, 0 };
-
-	instrs_[0x80] = { imm , NOP, 2, 0 };
-	instrs_[0x82] = { imm , NOP, 2, 0 };
-	instrs_[0x89] = { imm , NOP, 2, 0 };
-	instrs_[0xC2] = { imm , NOP, 2, 0 };
-	instrs_[0xE2] = { imm , NOP, 2, 0 };
-
-	instrs_[0x0C] = { abs , NOP, 4, 0 };
-
-	instrs_[0x1C] = { abx , NOP, 4, 1 };
-	instrs_[0x3C] = { abx , NOP, 4, 1 };
-	instrs_[0x5C] = { abx , NOP, 4, 1 };
-	instrs_[0x7C] = { abx , NOP, 4, 1 };
-	instrs_[0xDC] = { abx , NOP, 4, 1 };
-	instrs_[0xFC] = { abx , NOP, 4, 1 };
-
-	instrs_[0x04] = { zp  , NOP, 3, 0 };
-	instrs_[0x44] = { zp  , NOP, 3, 0 };
-	instrs_[0x64] = { zp  , NOP, 3, 0 };
-
-	instrs_[0x14] = { zpx , NOP, 4, 0 };
-	instrs_[0x34] = { zpx , NOP, 4, 0 };
-	instrs_[0x54] = { zpx , NOP, 4, 0 };
-	instrs_[0x74] = { zpx , NOP, 4, 0 };
-	instrs_[0xD4] = { zpx , NOP, 4, 0 };
-	instrs_[0xF4] = { zpx , NOP, 4, 0 }; */
-} 
+	table[0x1A] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+	table[0x3A] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+	table[0x5A] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+	table[0x7A] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+	table[0xDA] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+	table[0xFA] = instr<M::Imp, &CPU6502::NOP>(2, 0);
+
+	table[0x80] = instr<M::Imm, &CPU6502::NOP>(2, 0);
+	table[0x82] = instr<M::Imm, &CPU6502::NOP>(2, 0);
+	table[0x89] = instr<M::Imm, &CPU6502::NOP>(2, 0);
+	table[0xC2] = instr<M::Imm, &CPU6502::NOP>(2, 0);
+	table[0xE2] = instr<M::Imm, &CPU6502::NOP>(2, 0);
+
+	table[0x0C] = instr<M::Abs, &CPU6502::NOP>(4, 0);
+
+	table[0x1C] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+	table[0x3C] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+	table[0x5C] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+	table[0x7C] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+	table[0xDC] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+	table[0xFC] = instr<M::Abx, &CPU6502::NOP>(4, 1);
+
+	table[0x04] = instr<M::ZP, &CPU6502::NOP>(3, 0);
+	table[0x44] = instr<M::ZP, &CPU6502::NOP>(3, 0);
+	table[0x64] = instr<M::ZP, &CPU6502::NOP>(3, 0);
+
+	table[0x14] = instr<M::ZPX, &CPU6502::NOP>(4, 0);
+	table[0x34] = instr<M::ZPX, &CPU6502::NOP>(4, 0);
+	table[0x54] = instr<M::ZPX, &CPU6502::NOP>(4, 0);
+	table[0x74] = instr<M::ZPX, &CPU6502::NOP>(4, 0);
+	table[0xD4] = instr<M::ZPX, &CPU6502::NOP>(4, 0);
+	table[0xF4] = instr<M::ZPX, &CPU6502::NOP>(4, 0); */
+
+	return table;
+}
+
+constexpr std::array<CPU6502::Operation, CPU6502::instrs_size> CPU6502::s_operations = makeTable(&Instruction::execute);
+constexpr std::array<CPU6502::Timing, CPU6502::instrs_size> CPU6502::s_timings = makeTable(&Instruction::timing);
+constexpr std::array<u8, CPU6502::instrs_size> CPU6502::s_lengths = makeTable(&Instruction::length);
+
+CPU6502::CPU6502(Bus& bus) :
+	bus_{ bus }
+{
+}
+
+CPU6502::~CPU6502() = default;
 
 void CPU6502::cycle()
 {
 	switch (cycle_state_)
 	{
 	case CycleState::Fetch:
-		opcode_ = read(reg_.PC);
-		cycle_remained_ = instrs_[opcode_].cycles - 1;
+		if (backend_ != Backend::Interpreter)
+		{
+			if (const u32 cycles = runJIT(); cycles > 0)
+			{
+				// the block has already run, idle until the cycles it took have passed
+				penalty_ = static_cast<int>(cycles) - 1;
+				cycle_state_ = CycleState::WaitForPenalty;
+				break;
+			}
+		}
+		decoded_ = decode(reg_.PC);
+		if (decoded_)
+		{
+			cycle_remained_ = decoded_->cycles - 1;
+		}
+		else
+		{
+			opcode_ = read(reg_.PC);
+			cycle_remained_ = s_timings[opcode_].cycles - 1;
+		}
 		cycle_state_ = CycleState::Operate;
 		break;
 
@@ -446,19 +448,22 @@ void CPU6502::cycle()
 		--cycle_remained_;
 		if (cycle_remained_ <= 0)
 		{
-			opcode_ = getByteFromPC();
+			if (decoded_)
+			{
+				opcode_ = decoded_->opcode;
+				++reg_.PC;
+			}
+			else
+			{
+				opcode_ = getByteFromPC();
+			}
 #ifdef EMUCPULOG
 			log_regs = reg_;
 			log_cycles = total_cycles_ + 1;
 #endif
 
-			instrs_[opcode_].addr_mode();
-
-#ifdef EMUCPULOG
-			print(reg_.PC - log_regs.PC);
-#endif
-
-			instrs_[opcode_].operate();
+			(this->*(decoded_ ? decoded_->execute : s_operations[opcode_]))();
+			decoded_ = nullptr;
 
 			if (penalty_ <= 0)
 			{
@@ -488,12 +493,187 @@ void CPU6502::cycle()
 
 void CPU6502::write(const u16 addr, const u8 data)
 {
-	Bus::instance().cpuWrite(addr, data);
+	bus_.cpuWrite(addr, data);
 }
 
 u8 CPU6502::read(const u16 addr)
 {
-	return Bus::instance().cpuRead(addr);
+	return bus_.cpuRead(addr);
+}
+
+void CPU6502::serialize(StateArchive& ar)
+{
+	// the addressing temporaries are set again by every instruction before use
+	ar(reg_, total_cycles_, cycle_remained_, penalty_, cycle_state_);
+	if (ar.loading())
+	{
+		// an instruction in flight finishes on the plain path, which reads
+		// the same bytes the decoded one had
+		decoded_ = nullptr;
+		window_valid_ = false;
+	}
+}
+
+void CPU6502::flushDecodeCache()
+{
+	decoded_pages_.clear();
+	decoded_ = nullptr;
+	window_valid_ = false;
+	if (jit_)
+		jit_->flush();
+}
+
+void CPU6502::setBackend(const Backend backend)
+{
+	backend_ = JIT6502::supported() ? backend : Backend::Interpreter;
+	if (backend_ == Backend::Interpreter)
+	{
+		jit_.reset();
+		return;
+	}
+	if (!jit_)
+		jit_ = std::make_unique<JIT6502>(bus_);
+	jit_->flush();
+}
+
+CPU6502::Backend CPU6502::backend() const
+{
+	return backend_;
+}
+
+u32 CPU6502::runJIT()
+{
+	const u32 budget = bus_.cpuRunAheadBudget();
+	if (budget == 0)
+		return 0;
+	if (backend_ == Backend::JITDifferential)
+		return runJITDifferential(budget);
+	return jit_->run(*this, budget).cycles;
+}
+
+u32 CPU6502::runJITDifferential(const u32 budget)
+{
+	u8* const ram = bus_.RAM();
+	const Registers entry = reg_;
+	diff_ram_.assign(ram, ram + Bus::cpu_mem_size);
+
+	const JIT6502::Result jit = jit_->run(*this, budget);
+	if (jit.instructions == 0)
+		return 0;
+
+	const Registers jit_regs = reg_;
+	diff_jit_ram_.assign(ram, ram + Bus::cpu_mem_size);
+
+	// replay the same instructions with the interpreter from the same state
+	reg_ = entry;
+	std::copy(diff_ram_.begin(), diff_ram_.end(), ram);
+	u32 cycles = 0;
+	for (u32 i = 0; i < jit.instructions; ++i)
+		cycles += step();
+
+	const bool same_regs = jit_regs.A == reg_.A && jit_regs.X == reg_.X && jit_regs.Y == reg_.Y
+		&& jit_regs.Status == reg_.Status && jit_regs.SP == reg_.SP && jit_regs.PC == reg_.PC;
+	const bool same_ram = std::equal(diff_jit_ram_.begin(), diff_jit_ram_.end(), ram);
+	if (!same_regs || !same_ram || jit.cycles != cycles)
+	{
+		++jit_mismatches_;
+		std::fprintf(stderr, "[JIT] Block at %04X differs from the interpreter after %u instructions: "
+			"A:%02X/%02X X:%02X/%02X Y:%02X/%02X P:%02X/%02X SP:%02X/%02X PC:%04X/%04X cycles:%u/%u%s\n",
+			(int)entry.PC, jit.instructions,
+			(int)jit_regs.A, (int)reg_.A, (int)jit_regs.X, (int)reg_.X, (int)jit_regs.Y, (int)reg_.Y,
+			(int)jit_regs.Status, (int)reg_.Status, (int)jit_regs.SP, (int)reg_.SP,
+			(int)jit_regs.PC, (int)reg_.PC, jit.cycles, cycles, same_ram ? "" : " RAM differs");
+		jit_->reject(entry.PC);
+	}
+	// the interpreter's result is the one that is kept
+	return cycles;
+}
+
+u32 CPU6502::step()
+{
+	opcode_ = getByteFromPC();
+	(this->*s_operations[opcode_])();
+	const u32 cycles = s_timings[opcode_].cycles + penalty_;
+	penalty_ = 0;
+	setBitN(reg_.Status, 5, true);
+	return cycles;
+}
+
+const CPU6502::DecodedInstr* CPU6502::decode(const u16 addr)
+{
+	Mapper& cart = bus_.cartridge();
+	const u16 base = addr & ~static_cast<u16>(decode_page_size - 1);
+	if (!window_valid_ || base != window_base_ || cart.prgBankGeneration() != window_generation_)
+	{
+		window_ptr_ = cart.prgRomPtr(base);
+		window_base_ = base;
+		window_generation_ = cart.prgBankGeneration();
+		window_valid_ = true;
+	}
+	if (window_ptr_ == nullptr) // running from RAM or I/O, never cached
+		return nullptr;
+
+	const u8* rom = cart.PRGRom();
+	const usize offset = static_cast<usize>(window_ptr_ - rom) + (addr - base);
+	const usize page = offset / decode_page_size;
+	if (page >= decoded_pages_.size())
+		decoded_pages_.resize(page + 1);
+	if (!decoded_pages_[page])
+		decoded_pages_[page] = std::make_unique<DecodedPage>();
+
+	const DecodedInstr& instr = (*decoded_pages_[page])[offset % decode_page_size];
+	if (instr.length == 0)
+		decodeBlock(addr, rom, offset);
+	return instr.cacheable ? &instr : nullptr;
+}
+
+void CPU6502::decodeBlock(u16 addr, const u8* rom, usize offset)
+{
+	// pre-decode the straight-line run starting at addr, up to the first
+	// control flow instruction or the end of the current 1KB window
+	while (true)
+	{
+		DecodedInstr& instr = (*decoded_pages_[offset / decode_page_size])[offset % decode_page_size];
+		if (instr.length != 0)
+			break;
+
+		const u8 opcode = rom[offset];
+		const u8 length = s_lengths[opcode];
+		const usize in_window = addr % decode_page_size;
+
+		instr.opcode = opcode;
+		instr.length = length;
+		instr.execute = s_operations[opcode];
+		instr.cycles = s_timings[opcode].cycles;
+		// the operand bytes of an instruction that straddles the window may
+		// live in another bank, so leave it to the regular fetch path
+		instr.cacheable = (in_window + length <= decode_page_size);
+		if (!instr.cacheable)
+			break;
+		if (length >= 2)
+			instr.operand = rom[offset + 1];
+		if (length == 3)
+			instr.operand |= static_cast<u16>(rom[offset + 2]) << 8;
+
+		if (endsBlock(opcode) || in_window + length == decode_page_size)
+			break;
+		addr += length;
+		offset += length;
+	}
+}
+
+bool CPU6502::endsBlock(const u8 opcode) const
+{
+	switch (opcode)
+	{
+	case 0x00: // BRK
+	case 0x20: // JSR
+	case 0x40: // RTI
+	case 0x4C: case 0x6C: // JMP
+	case 0x60: // RTS
+		return true;
+	}
+	return (opcode & 0x1F) == 0x10; // branches
 }
 
 void CPU6502::reset()
@@ -1042,7 +1222,7 @@ void CPU6502::relativeDisplace()
 	reg_.PC = abs_addr_;
 	++penalty_; // branch succeeds penalty
 	if (pageCrossed(old_pc, reg_.PC))
-		penalty_ += instrs_[opcode_].penalty;
+		penalty_ += s_timings[opcode_].penalty;
 }
 
 void CPU6502::none()
@@ -1102,7 +1282,7 @@ void CPU6502::abx()
 	const u16 addr = getTwoBytesFromPC();
 	abs_addr_ = addr + static_cast<u16>(reg_.X);
 	if (pageCrossed(addr, abs_addr_))
-		penalty_ += instrs_[opcode_].penalty;
+		penalty_ += s_timings[opcode_].penalty;
 }
 
 void CPU6502::aby()
@@ -1111,7 +1291,7 @@ void CPU6502::aby()
 	const u16 addr = getTwoBytesFromPC();
 	abs_addr_ = addr + static_cast<u16>(reg_.Y);
 	if (pageCrossed(addr, abs_addr_))
-		penalty_ += instrs_[opcode_].penalty;
+		penalty_ += s_timings[opcode_].penalty;
 }
 
 void CPU6502::ind()
@@ -1143,7 +1323,7 @@ void CPU6502::indIdx()
 	const u16 addr = getTwoBytesFromZP(table_loc);
 	abs_addr_ = addr + static_cast<u16>(reg_.Y);
 	if (pageCrossed(addr, abs_addr_))
-		penalty_ += instrs_[opcode_].penalty;
+		penalty_ += s_timings[opcode_].penalty;
 }
 
 u8 CPU6502::fetch()
@@ -1157,11 +1337,21 @@ u8 CPU6502::fetch()
 
 u8 CPU6502::getByteFromPC()
 {
+	if (decoded_)
+	{
+		++reg_.PC;
+		return static_cast<u8>(decoded_->operand);
+	}
 	return read(reg_.PC++);
 }
 
 u16 CPU6502::getTwoBytesFromPC()
 {
+	if (decoded_)
+	{
+		reg_.PC += 2;
+		return decoded_->operand;
+	}
 	u16 result = read(reg_.PC++);
 	result |= (static_cast<u16>(read(reg_.PC++)) << 8);
 	return result;
@@ -4,10 +4,15 @@
 
 // #define EMUCPULOG
 
+class Bus;
+class JIT6502;
+class StateArchive;
+
 class CPU6502
 {
 public:
-	CPU6502();
+	explicit CPU6502(Bus& bus);
+	~CPU6502();
 
 	void cycle();
 
@@ -16,18 +21,30 @@ public:
 
 	void reset();
 
+	void flushDecodeCache();
+
+	// registers and where the current instruction is at
+	void serialize(StateArchive& ar);
+
+	enum class Backend
+	{
+		Interpreter,
+		JIT,
+		JITDifferential // runs every translated block through the interpreter too and compares the results
+	};
+
+	// falls back to the interpreter if the host has no JIT support
+	void setBackend(Backend backend);
+	Backend backend() const;
+
 	bool nmi();
 
 	bool irq();
 
 private:
-	struct Instruction
-	{
-		std::function<void(void)> addr_mode;
-		std::function<void(void)> operate;
-		u8 cycles  = 0;
-		u8 penalty = 0; // page crossed penalty
-	};
+	friend class JIT6502;
+
+	Bus& bus_;
 
 	u16 abs_addr_ = 0;
 	u8 opcode_ = 0;
@@ -127,8 +144,84 @@ private:
 	static constexpr std::size_t instrs_size = 256;
 	static constexpr u16 stack_low = 0x0100;
 
-	std::vector<Instruction> instrs_;
+	using Operation = void (CPU6502::*)();
+
+	struct Timing
+	{
+		u8 cycles  = 0;
+		u8 penalty = 0; // page crossed penalty
+	};
+
+	struct Instruction
+	{
+		Operation execute = nullptr;
+		Timing timing;
+		u8 length = 0; // in bytes, including the opcode
+	};
+
+	template<AddrMode mode, Operation operate>
+	void execute();
+
+	template<AddrMode mode, Operation operate>
+	static constexpr Instruction instr(u8 cycles, u8 penalty);
+
+	static constexpr std::array<Instruction, instrs_size> makeInstructionTable();
+
+	template<typename T>
+	static constexpr std::array<T, instrs_size> makeTable(T Instruction::*field)
+	{
+		constexpr auto instrs = makeInstructionTable();
+		std::array<T, instrs_size> table{};
+		for (std::size_t i = 0; i < instrs_size; ++i)
+			table[i] = instrs[i].*field;
+		return table;
+	}
+
+	// opcode -> addressing mode x operation handler, instantiated at compile time
+	static const std::array<Operation, instrs_size> s_operations;
+	// opcode -> base cycles and page crossed penalty, kept dense for the fetch cycle
+	static const std::array<Timing, instrs_size> s_timings;
+	static const std::array<u8, instrs_size> s_lengths;
+
+	// Instructions decoded from PRG ROM, indexed by their offset in the ROM. The
+	// ROM never changes, so an entry stays valid for the lifetime of the cartridge;
+	// only the CPU address -> ROM mapping has to be re-checked after a bank switch.
+	struct DecodedInstr
+	{
+		Operation execute = nullptr;
+		u16 operand = 0;
+		u8 opcode = 0;
+		u8 cycles = 0;
+		u8 length = 0; // 0 until decoded
+		bool cacheable = false;
+	};
+
+	static constexpr std::size_t decode_page_size = 1024;
+	using DecodedPage = std::array<DecodedInstr, decode_page_size>;
+
+	const DecodedInstr* decode(u16 addr);
+	void decodeBlock(u16 addr, const u8* rom, usize offset);
+	bool endsBlock(u8 opcode) const;
+
+	std::vector<std::unique_ptr<DecodedPage>> decoded_pages_;
+	const DecodedInstr* decoded_ = nullptr;
+
+	// the 1KB window of CPU address space the PC was last fetched from
+	const u8* window_ptr_ = nullptr;
+	u16 window_base_ = 0;
+	u32 window_generation_ = 0;
+	bool window_valid_ = false;
 	
+	u32 runJIT();
+	u32 runJITDifferential(u32 budget);
+	u32 step(); // runs one whole instruction right away, returns its cycles
+
+	Backend backend_ = Backend::Interpreter;
+	std::unique_ptr<JIT6502> jit_;
+	std::vector<u8> diff_ram_; // scratch copies of RAM for the differential mode
+	std::vector<u8> diff_jit_ram_;
+	u64 jit_mismatches_ = 0;
+
 	u64 total_cycles_ = 0;
 	int cycle_remained_ = 0, penalty_ = 0;
 
@@ -79,8 +79,16 @@ u8 Cartridge::loadiNESFile(const std::filesystem::path& path)
     }
     else
     {
-        chr_mem_.resize(8_KB); // CHR RAM
-        use_chr_ram_ = true;
+        use_chr_ram_ = true; // 8KB, part of MachineMemory
+    }
+
+    rom_hash_ = 0xCBF29CE484222325;
+    for (const std::vector<u8>* rom : { &prg_rom_, &chr_mem_ })
+    {
+        for (const u8 byte : *rom)
+        {
+            rom_hash_ = (rom_hash_ ^ byte) * 0x100000001B3;
+        }
     }
 
     mirror_type = (getBitN(header.flag6, 0) ? MirrorType::Vertical : MirrorType::Horizontal);
@@ -109,8 +117,13 @@ usize Cartridge::PRGRomSize() const
     return prg_rom_.size();
 }
 
+u64 Cartridge::romHash() const
+{
+    return rom_hash_;
+}
+
 usize Cartridge::CHRMemSize() const
 {
-    return chr_mem_.size();
+    return use_chr_ram_ ? 8_KB : chr_mem_.size();
 }
 
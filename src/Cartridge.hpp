@@ -23,14 +23,18 @@ public:
 	bool useCHRRam() const;
 
 	u8* const PRGRom();
-	u8* const CHRMem();
+	u8* const CHRMem(); // CHR ROM only, CHR RAM is part of MachineMemory
 
 	usize PRGRomSize() const;
 	usize CHRMemSize() const;
 
+	// 64 bit FNV-1a of PRG ROM followed by CHR ROM, tells ROMs apart in save states
+	u64 romHash() const;
+
 	MirrorType mirror_type = MirrorType::FourScreen;
 
 private:
 	bool use_chr_ram_ = false;
+	u64 rom_hash_ = 0;
 	std::vector<u8> prg_rom_, chr_mem_;
 };
\ No newline at end of file
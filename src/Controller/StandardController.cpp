@@ -34,3 +34,13 @@ void StandardController::setBotton(const Botton botton, const bool set)
 		reg_ = reg_ & (~botton);
 	}
 }
+
+u8 StandardController::buttons() const
+{
+	return reg_;
+}
+
+void StandardController::setButtons(const u8 buttons)
+{
+	reg_ = buttons;
+}
@@ -23,6 +23,10 @@ public:
 
 	void setBotton(Botton botton, bool set);
 
+	// all eight buttons, one bit each as in Botton
+	u8 buttons() const;
+	void setButtons(u8 buttons);
+
 private:
 	u8 reg_ = 0;
 
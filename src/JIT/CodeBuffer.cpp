@@ -0,0 +1,46 @@
+#include "CodeBuffer.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+CodeBuffer::CodeBuffer(const usize size) :
+	size_{ size }
+{
+#ifdef _WIN32
+	data_ = static_cast<u8*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	data_ = (mem == MAP_FAILED) ? nullptr : static_cast<u8*>(mem);
+#endif
+	if (data_ == nullptr)
+	{
+		throw std::runtime_error{ "Cannot allocate executable memory" };
+	}
+}
+
+CodeBuffer::~CodeBuffer()
+{
+#ifdef _WIN32
+	VirtualFree(data_, 0, MEM_RELEASE);
+#else
+	munmap(data_, size_);
+#endif
+}
+
+u8* CodeBuffer::data()
+{
+	return data_;
+}
+
+usize CodeBuffer::size() const
+{
+	return size_;
+}
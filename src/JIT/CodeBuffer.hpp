@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../common/type.hpp"
+
+
+// A fixed size block of memory that is both writable and executable.
+class CodeBuffer
+{
+public:
+	explicit CodeBuffer(usize size);
+	~CodeBuffer();
+
+	CodeBuffer(const CodeBuffer&) = delete;
+	CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+	u8* data();
+	usize size() const;
+
+private:
+	u8* data_ = nullptr;
+	usize size_ = 0;
+};
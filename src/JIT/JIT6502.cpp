@@ -0,0 +1,752 @@
+#include "JIT6502.hpp"
+#include "../CPU6502.hpp"
+#include "../Bus.hpp"
+
+#include <cassert>
+#include <cstddef>
+
+
+namespace
+{
+	enum Op : u8
+	{
+		None,
+		ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC,
+		CLD, CLI, CLV, CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, JMP,
+		JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, ROL, ROR, RTI,
+		RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA
+	};
+
+	enum Mode : u8
+	{
+		Imp,
+		Imm,
+		ZP, ZPX, ZPY,
+		Rel,
+		Abs, Abx, Aby,
+		Ind, IdxInd, IndIdx
+	};
+
+	struct OpInfo
+	{
+		Op op = None;
+		Mode mode = Imp;
+	};
+
+	// official opcodes only, the same set the interpreter implements
+	constexpr OpInfo s_op_info[256] = {
+	/* 00 */ { BRK, Imp }, { ORA, IdxInd }, {},           {}, {},           { ORA, ZP },  { ASL, ZP },  {},
+	/* 08 */ { PHP, Imp }, { ORA, Imm },    { ASL, Imp }, {}, {},           { ORA, Abs }, { ASL, Abs }, {},
+	/* 10 */ { BPL, Rel }, { ORA, IndIdx }, {},           {}, {},           { ORA, ZPX }, { ASL, ZPX }, {},
+	/* 18 */ { CLC, Imp }, { ORA, Aby },    {},           {}, {},           { ORA, Abx }, { ASL, Abx }, {},
+	/* 20 */ { JSR, Abs }, { AND, IdxInd }, {},           {}, { BIT, ZP },  { AND, ZP },  { ROL, ZP },  {},
+	/* 28 */ { PLP, Imp }, { AND, Imm },    { ROL, Imp }, {}, { BIT, Abs }, { AND, Abs }, { ROL, Abs }, {},
+	/* 30 */ { BMI, Rel }, { AND, IndIdx }, {},           {}, {},           { AND, ZPX }, { ROL, ZPX }, {},
+	/* 38 */ { SEC, Imp }, { AND, Aby },    {},           {}, {},           { AND, Abx }, { ROL, Abx }, {},
+	/* 40 */ { RTI, Imp }, { EOR, IdxInd }, {},           {}, {},           { EOR, ZP },  { LSR, ZP },  {},
+	/* 48 */ { PHA, Imp }, { EOR, Imm },    { LSR, Imp }, {}, { JMP, Abs }, { EOR, Abs }, { LSR, Abs }, {},
+	/* 50 */ { BVC, Rel }, { EOR, IndIdx }, {},           {}, {},           { EOR, ZPX }, { LSR, ZPX }, {},
+	/* 58 */ { CLI, Imp }, { EOR, Aby },    {},           {}, {},           { EOR, Abx }, { LSR, Abx }, {},
+	/* 60 */ { RTS, Imp }, { ADC, IdxInd }, {},           {}, {},           { ADC, ZP },  { ROR, ZP },  {},
+	/* 68 */ { PLA, Imp }, { ADC, Imm },    { ROR, Imp }, {}, { JMP, Ind }, { ADC, Abs }, { ROR, Abs }, {},
+	/* 70 */ { BVS, Rel }, { ADC, IndIdx }, {},           {}, {},           { ADC, ZPX }, { ROR, ZPX }, {},
+	/* 78 */ { SEI, Imp }, { ADC, Aby },    {},           {}, {},           { ADC, Abx }, { ROR, Abx }, {},
+	/* 80 */ {},           { STA, IdxInd }, {},           {}, { STY, ZP },  { STA, ZP },  { STX, ZP },  {},
+	/* 88 */ { DEY, Imp }, {},              { TXA, Imp }, {}, { STY, Abs }, { STA, Abs }, { STX, Abs }, {},
+	/* 90 */ { BCC, Rel }, { STA, IndIdx }, {},           {}, { STY, ZPX }, { STA, ZPX }, { STX, ZPY }, {},
+	/* 98 */ { TYA, Imp }, { STA, Aby },    { TXS, Imp }, {}, {},           { STA, Abx }, {},           {},
+	/* A0 */ { LDY, Imm }, { LDA, IdxInd }, { LDX, Imm }, {}, { LDY, ZP },  { LDA, ZP },  { LDX, ZP },  {},
+	/* A8 */ { TAY, Imp }, { LDA, Imm },    { TAX, Imp }, {}, { LDY, Abs }, { LDA, Abs }, { LDX, Abs }, {},
+	/* B0 */ { BCS, Rel }, { LDA, IndIdx }, {},           {}, { LDY, ZPX }, { LDA, ZPX }, { LDX, ZPY }, {},
+	/* B8 */ { CLV, Imp }, { LDA, Aby },    { TSX, Imp }, {}, { LDY, Abx }, { LDA, Abx }, { LDX, Aby }, {},
+	/* C0 */ { CPY, Imm }, { CMP, IdxInd }, {},           {}, { CPY, ZP },  { CMP, ZP },  { DEC, ZP },  {},
+	/* C8 */ { INY, Imp }, { CMP, Imm },    { DEX, Imp }, {}, { CPY, Abs }, { CMP, Abs }, { DEC, Abs }, {},
+	/* D0 */ { BNE, Rel }, { CMP, IndIdx }, {},           {}, {},           { CMP, ZPX }, { DEC, ZPX }, {},
+	/* D8 */ { CLD, Imp }, { CMP, Aby },    {},           {}, {},           { CMP, Abx }, { DEC, Abx }, {},
+	/* E0 */ { CPX, Imm }, { SBC, IdxInd }, {},           {}, { CPX, ZP },  { SBC, ZP },  { INC, ZP },  {},
+	/* E8 */ { INX, Imp }, { SBC, Imm },    { NOP, Imp }, {}, { CPX, Abs }, { SBC, Abs }, { INC, Abs }, {},
+	/* F0 */ { BEQ, Rel }, { SBC, IndIdx }, {},           {}, {},           { SBC, ZPX }, { INC, ZPX }, {},
+	/* F8 */ { SED, Imp }, { SBC, Aby },    {},           {}, {},           { SBC, Abx }, { INC, Abx }, {},
+	};
+
+	enum class Access
+	{
+		None,
+		Read,
+		Write,
+		Modify
+	};
+
+	Access accessOf(const OpInfo info)
+	{
+		switch (info.op)
+		{
+		case ADC: case AND: case BIT: case CMP: case CPX: case CPY:
+		case EOR: case LDA: case LDX: case LDY: case ORA: case SBC:
+			return info.mode == Imm ? Access::None : Access::Read;
+
+		case STA: case STX: case STY:
+			return Access::Write;
+
+		case ASL: case DEC: case INC: case LSR: case ROL: case ROR:
+			return info.mode == Imp ? Access::None : Access::Modify;
+
+		default:
+			return Access::None;
+		}
+	}
+
+	using Reg = X64Emitter::Reg;
+	using Mem = X64Emitter::Mem;
+	using Context = JIT6502::Context;
+
+	// rbx holds the Context* for the whole block, rax/rcx/rdx/rsi are scratch
+	constexpr Mem field(const usize offset)
+	{
+		return X64Emitter::at(X64Emitter::RBX, static_cast<i32>(offset));
+	}
+
+	constexpr Mem reg_A      = field(offsetof(Context, A));
+	constexpr Mem reg_X      = field(offsetof(Context, X));
+	constexpr Mem reg_Y      = field(offsetof(Context, Y));
+	constexpr Mem reg_SP     = field(offsetof(Context, SP));
+	constexpr Mem reg_Status = field(offsetof(Context, Status));
+	constexpr Mem reg_PC     = field(offsetof(Context, PC));
+	constexpr Mem cycles     = field(offsetof(Context, cycles));
+	constexpr Mem budget     = field(offsetof(Context, budget));
+	constexpr Mem instrs     = field(offsetof(Context, instructions));
+	constexpr Mem ram        = field(offsetof(Context, ram));
+	constexpr Mem stack      = X64Emitter::at(X64Emitter::RSI, X64Emitter::RCX, 0x0100); // ram + 0x100 + SP
+	constexpr Mem ram_byte   = X64Emitter::at(X64Emitter::RSI, X64Emitter::RCX);
+
+	constexpr u8 carry_flag    = 0x01;
+	constexpr u8 zero_flag     = 0x02;
+	constexpr u8 irq_flag      = 0x04;
+	constexpr u8 decimal_flag  = 0x08;
+	constexpr u8 break_flag    = 0x10;
+	constexpr u8 unused_flag   = 0x20;
+	constexpr u8 overflow_flag = 0x40;
+	constexpr u8 negative_flag = 0x80;
+
+#ifdef _WIN32
+	constexpr Reg arg0 = X64Emitter::RCX, arg1 = X64Emitter::RDX;
+#else
+	constexpr Reg arg0 = X64Emitter::RDI, arg1 = X64Emitter::RSI;
+#endif
+}
+
+JIT6502::JIT6502(Bus& bus) :
+	bus_{ bus },
+	entries_(0x8000)
+{
+	for (usize i = 0; i < ctx_.nz.size(); ++i)
+	{
+		ctx_.nz[i] = (i == 0 ? zero_flag : 0) | (i & negative_flag);
+	}
+	if (supported())
+	{
+		code_ = std::make_unique<CodeBuffer>(code_buffer_size);
+		emitter_.setBuffer(code_->data(), code_->size());
+	}
+}
+
+bool JIT6502::supported()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#else
+	return false;
+#endif
+}
+
+JIT6502::Result JIT6502::run(CPU6502& cpu, const u32 budget)
+{
+	if (!code_)
+		return {};
+
+	Mapper& cart = bus_.cartridge();
+	if (cart.prgBankGeneration() != bank_generation_)
+	{
+		flush();
+		bank_generation_ = cart.prgBankGeneration();
+	}
+
+	const u16 pc = cpu.reg_.PC;
+	if (pc < 0x8000) // code in RAM may rewrite itself, leave it to the interpreter
+		return {};
+
+	Entry* e = &entry(pc);
+	if (e->block == nullptr)
+	{
+		if (e->rejected || ++e->hits < hot_threshold)
+			return {};
+		if (emitter_.remaining() < max_block_bytes)
+		{
+			flush();
+			e = &entry(pc);
+		}
+		e->block = translate(pc);
+		if (e->block == nullptr)
+		{
+			e->rejected = true;
+			return {};
+		}
+	}
+
+	ctx_.A = cpu.reg_.A;
+	ctx_.X = cpu.reg_.X;
+	ctx_.Y = cpu.reg_.Y;
+	ctx_.SP = cpu.reg_.SP;
+	ctx_.Status = cpu.reg_.Status;
+	ctx_.PC = pc;
+	ctx_.cycles = 0;
+	ctx_.budget = budget;
+	ctx_.instructions = 0;
+	ctx_.ram = bus_.RAM();
+	ctx_.cpu = &cpu;
+
+	e->block(&ctx_);
+
+	cpu.reg_.A = ctx_.A;
+	cpu.reg_.X = ctx_.X;
+	cpu.reg_.Y = ctx_.Y;
+	cpu.reg_.SP = ctx_.SP;
+	cpu.reg_.Status = ctx_.Status;
+	cpu.reg_.PC = static_cast<u16>(ctx_.PC);
+	return { ctx_.cycles, ctx_.instructions };
+}
+
+void JIT6502::flush()
+{
+	++generation_;
+	if (code_)
+		emitter_.setBuffer(code_->data(), code_->size());
+}
+
+void JIT6502::reject(const u16 pc)
+{
+	if (pc < 0x8000)
+		return;
+	Entry& e = entry(pc);
+	e.block = nullptr;
+	e.rejected = true;
+}
+
+JIT6502::Entry& JIT6502::entry(const u16 pc)
+{
+	Entry& e = entries_[pc - 0x8000];
+	if (e.generation != generation_)
+	{
+		e = Entry{};
+		e.generation = generation_;
+	}
+	return e;
+}
+
+u32 JIT6502::readMemory(Context* ctx, const u32 addr)
+{
+	return ctx->cpu->read(static_cast<u16>(addr));
+}
+
+bool JIT6502::translatable(const u8 opcode, const u16 operand) const
+{
+	const OpInfo info = s_op_info[opcode];
+	switch (info.op)
+	{
+	case None:
+	case BRK:
+	case RTI:
+		return false;
+
+	case JMP:
+		return info.mode == Abs;
+
+	default:
+		break;
+	}
+
+	const Access access = accessOf(info);
+	if (info.mode != Abs || access == Access::None)
+		return true;
+	if (operand < 0x2000) // internal RAM
+		return true;
+	// reading the cartridge has no side effect, anything else is left to the interpreter
+	return access == Access::Read && operand >= 0x6000;
+}
+
+JIT6502::Block JIT6502::translate(const u16 pc)
+{
+	using X = X64Emitter;
+	X64Emitter& e = emitter_;
+	Mapper& cart = bus_.cartridge();
+
+	instr_offsets_.clear();
+	exits_.clear();
+
+	e.push(X::RBX);
+	e.push(X::RSI);
+	e.push(X::RDI);
+	e.subRsp(32); // keeps the stack aligned and doubles as the win64 shadow space
+	e.mov64(X::RBX, arg0);
+	const X::Label body = e.jmp();
+
+	epilogue_ = e.here();
+	e.addRsp(32);
+	e.pop(X::RDI);
+	e.pop(X::RSI);
+	e.pop(X::RBX);
+	e.ret();
+
+	u16 addr = pc;
+	bool ended = false;
+	while (!ended && instr_offsets_.size() < max_block_instrs)
+	{
+		const u8* opcode = cart.prgRomPtr(addr);
+		if (opcode == nullptr)
+			break;
+		const u8 length = CPU6502::s_lengths[*opcode];
+		u16 operand = 0;
+		bool in_rom = true;
+		for (u8 i = 1; i < length && in_rom; ++i)
+		{
+			const u8* byte = cart.prgRomPtr(static_cast<u16>(addr + i));
+			in_rom = (byte != nullptr) && static_cast<u16>(addr + i) >= 0x8000;
+			if (in_rom)
+				operand |= static_cast<u16>(*byte) << (8 * (i - 1));
+		}
+		if (!in_rom || !translatable(*opcode, operand))
+			break;
+
+		instr_offsets_.emplace_back(addr, e.here());
+		emitBudgetCheck(addr);
+		if (instr_offsets_.size() == 1)
+			e.bind(body); // the first instruction always runs, its check is only for loops back to it
+		ended = emitInstruction(addr, *opcode, operand);
+		addr += length;
+		if (addr < 0x8000)
+			break;
+	}
+
+	if (instr_offsets_.empty())
+	{
+		e.rollback();
+		return nullptr;
+	}
+	if (!ended)
+		emitExit(e.jmp(), addr);
+
+	for (const auto& [label, exit_pc] : exits_)
+	{
+		e.bind(label);
+		e.mov32(reg_PC, static_cast<u32>(exit_pc));
+		e.jmp(epilogue_);
+	}
+
+	assert(e.size() <= max_block_bytes);
+	const Block block = reinterpret_cast<Block>(e.begin());
+	e.commit();
+	return block;
+}
+
+void JIT6502::emitBudgetCheck(const u16 pc)
+{
+	using X = X64Emitter;
+	emitter_.mov32(X::RAX, cycles);
+	emitter_.cmp32(X::RAX, budget);
+	emitExit(emitter_.jcc(X::AE), pc);
+}
+
+void JIT6502::emitAccount(const u8 opcode)
+{
+	emitter_.add32(cycles, static_cast<i8>(CPU6502::s_timings[opcode].cycles));
+	emitter_.add32(instrs, 1);
+}
+
+void JIT6502::emitPenalty(const u8 opcode, const Mem& index)
+{
+	using X = X64Emitter;
+	const u8 penalty = CPU6502::s_timings[opcode].penalty;
+	if (penalty == 0)
+		return;
+	// the low byte of the effective address in cl wrapped around iff it ended up below the index
+	emitter_.movzx8(X::RAX, index);
+	emitter_.cmp8(X::RCX, X::RAX);
+	const X::Label same_page = emitter_.jcc(X::AE);
+	emitter_.add32(cycles, static_cast<i8>(penalty));
+	emitter_.bind(same_page);
+}
+
+void JIT6502::emitNZ(const Reg value)
+{
+	using X = X64Emitter;
+	emitter_.movzx8(X::RAX, value);
+	emitter_.and8(reg_Status, static_cast<u8>(~(negative_flag | zero_flag)));
+	emitter_.mov8(X::RDX, X::at(X::RBX, X::RAX, static_cast<i32>(offsetof(Context, nz))));
+	emitter_.or8(reg_Status, X::RDX);
+}
+
+void JIT6502::emitExit(const X64Emitter::Label label, const u16 pc)
+{
+	exits_.emplace_back(label, pc);
+}
+
+void JIT6502::emitBranchTo(const u16 target)
+{
+	for (const auto& [pc, offset] : instr_offsets_)
+	{
+		if (pc == target) // a loop inside this block
+		{
+			emitter_.jmp(offset);
+			return;
+		}
+	}
+	emitExit(emitter_.jmp(), target);
+}
+
+void JIT6502::emitCallRead()
+{
+	using X = X64Emitter;
+	emitter_.mov32(arg1, X::RCX);
+	emitter_.mov64(arg0, X::RBX);
+	emitter_.call(reinterpret_cast<const void*>(&JIT6502::readMemory));
+}
+
+bool JIT6502::emitInstruction(const u16 pc, const u8 opcode, const u16 operand)
+{
+	using X = X64Emitter;
+	X64Emitter& e = emitter_;
+	const OpInfo info = s_op_info[opcode];
+	const Access access = accessOf(info);
+	const u8 zp = static_cast<u8>(operand);
+
+	// effective address into ecx
+	bool dynamic = false; // only known at run time, may point anywhere
+	switch (info.mode)
+	{
+	case ZP:
+		e.mov32(X::RCX, zp);
+		break;
+
+	case ZPX:
+	case ZPY:
+		e.movzx8(X::RCX, info.mode == ZPX ? reg_X : reg_Y);
+		e.add32(X::RCX, zp);
+		e.and32(X::RCX, 0xFF);
+		break;
+
+	case Abs:
+		e.mov32(X::RCX, operand);
+		break;
+
+	case Abx:
+	case Aby:
+		e.movzx8(X::RCX, info.mode == Abx ? reg_X : reg_Y);
+		e.add32(X::RCX, operand);
+		e.and32(X::RCX, 0xFFFF);
+		dynamic = true;
+		break;
+
+	case IdxInd:
+		e.movzx8(X::RAX, reg_X);
+		e.add32(X::RAX, zp);
+		e.and32(X::RAX, 0xFF);
+		e.mov64(X::RSI, ram);
+		e.movzx8(X::RCX, X::at(X::RSI, X::RAX));
+		e.add32(X::RAX, 1);
+		e.and32(X::RAX, 0xFF);
+		e.movzx8(X::RAX, X::at(X::RSI, X::RAX));
+		e.shl32(X::RAX, 8);
+		e.or32(X::RCX, X::RAX);
+		dynamic = true;
+		break;
+
+	case IndIdx:
+		e.mov64(X::RSI, ram);
+		e.movzx8(X::RCX, X::at(X::RSI, zp));
+		e.movzx8(X::RAX, X::at(X::RSI, static_cast<u8>(zp + 1)));
+		e.shl32(X::RAX, 8);
+		e.or32(X::RCX, X::RAX);
+		e.movzx8(X::RAX, reg_Y);
+		e.add32(X::RCX, X::RAX);
+		e.and32(X::RCX, 0xFFFF);
+		dynamic = true;
+		break;
+
+	default:
+		break;
+	}
+
+	// leave before touching anything if the address turns out to be I/O
+	if (dynamic && access != Access::None)
+	{
+		e.cmp32(X::RCX, 0x2000);
+		if (access == Access::Read)
+		{
+			const X::Label internal_ram = e.jcc(X::B);
+			e.cmp32(X::RCX, 0x6000);
+			emitExit(e.jcc(X::B), pc);
+			e.bind(internal_ram);
+		}
+		else
+		{
+			emitExit(e.jcc(X::AE), pc);
+		}
+	}
+
+	emitAccount(opcode);
+	if (info.mode == Abx)
+		emitPenalty(opcode, reg_X);
+	else if (info.mode == Aby || info.mode == IndIdx)
+		emitPenalty(opcode, reg_Y);
+
+	// operand into eax, for memory operands rsi + rcx is left pointing at it in RAM
+	if (info.mode == Imm)
+	{
+		e.mov32(X::RAX, zp);
+	}
+	else if (access == Access::Read || access == Access::Modify || access == Access::Write)
+	{
+		const bool ram_only = (access != Access::Read) || info.mode == ZP || info.mode == ZPX || info.mode == ZPY
+			|| (info.mode == Abs && operand < 0x2000);
+		X::Label cartridge = 0, done = 0;
+		if (!ram_only)
+		{
+			e.cmp32(X::RCX, 0x2000);
+			cartridge = e.jcc(X::AE);
+		}
+		e.mov64(X::RSI, ram);
+		e.and32(X::RCX, 0x07FF);
+		if (access != Access::Write)
+			e.movzx8(X::RAX, ram_byte);
+		if (!ram_only)
+		{
+			done = e.jmp();
+			e.bind(cartridge);
+			emitCallRead();
+			e.bind(done);
+		}
+	}
+
+	switch (info.op)
+	{
+	case LDA: e.mov8(reg_A, X::RAX); emitNZ(X::RAX); break;
+	case LDX: e.mov8(reg_X, X::RAX); emitNZ(X::RAX); break;
+	case LDY: e.mov8(reg_Y, X::RAX); emitNZ(X::RAX); break;
+
+	case STA: case STX: case STY:
+		e.movzx8(X::RAX, info.op == STA ? reg_A : info.op == STX ? reg_X : reg_Y);
+		e.mov8(ram_byte, X::RAX);
+		break;
+
+	case AND: case ORA: case EOR:
+		e.movzx8(X::RDX, reg_A);
+		if (info.op == AND)
+			e.and8(X::RDX, X::RAX);
+		else if (info.op == ORA)
+			e.or8(X::RDX, X::RAX);
+		else
+			e.xor8(X::RDX, X::RAX);
+		e.mov8(reg_A, X::RDX);
+		emitNZ(X::RDX);
+		break;
+
+	case ADC: case SBC:
+		// the 2A03 has no decimal mode, so this is plain binary add with carry
+		// and x86 computes the same carry and overflow flags
+		if (info.op == SBC)
+			e.not8(X::RAX);
+		e.movzx8(X::RCX, reg_A);
+		e.movzx8(X::RDX, reg_Status);
+		e.shr32(X::RDX, 1); // CF = C
+		e.adc8(X::RCX, X::RAX);
+		e.setcc(X::B, X::RDX);
+		e.setcc(X::O, X::RAX);
+		e.mov8(reg_A, X::RCX);
+		e.movzx8(X::RAX, X::RAX);
+		e.shl32(X::RAX, 6);
+		e.or32(X::RDX, X::RAX);
+		e.and8(reg_Status, static_cast<u8>(~(negative_flag | overflow_flag | zero_flag | carry_flag)));
+		e.or8(reg_Status, X::RDX);
+		emitNZ(X::RCX);
+		break;
+
+	case CMP: case CPX: case CPY:
+		e.movzx8(X::RCX, info.op == CMP ? reg_A : info.op == CPX ? reg_X : reg_Y);
+		e.cmp8(X::RCX, X::RAX);
+		e.setcc(X::AE, X::RDX);
+		e.sub8(X::RCX, X::RAX);
+		e.and8(reg_Status, static_cast<u8>(~carry_flag));
+		e.or8(reg_Status, X::RDX);
+		emitNZ(X::RCX);
+		break;
+
+	case BIT:
+		e.and8(reg_Status, static_cast<u8>(~(negative_flag | overflow_flag | zero_flag)));
+		e.mov32(X::RDX, X::RAX);
+		e.and32(X::RDX, negative_flag | overflow_flag);
+		e.or8(reg_Status, X::RDX);
+		e.test8(reg_A, X::RAX);
+		e.setcc(X::E, X::RDX);
+		e.add8(X::RDX, X::RDX); // zero flag is bit 1
+		e.or8(reg_Status, X::RDX);
+		break;
+
+	case ASL: case LSR: case ROL: case ROR:
+		if (info.mode == Imp)
+			e.movzx8(X::RAX, reg_A);
+		if (info.op == ROL || info.op == ROR)
+		{
+			e.movzx8(X::RDX, reg_Status);
+			e.shr32(X::RDX, 1); // CF = C
+		}
+		if (info.op == ASL)
+			e.shl8(X::RAX);
+		else if (info.op == LSR)
+			e.shr8(X::RAX);
+		else if (info.op == ROL)
+			e.rcl8(X::RAX);
+		else
+			e.rcr8(X::RAX);
+		e.setcc(X::B, X::RDX);
+		e.and8(reg_Status, static_cast<u8>(~carry_flag));
+		e.or8(reg_Status, X::RDX);
+		if (info.mode == Imp)
+			e.mov8(reg_A, X::RAX);
+		else
+			e.mov8(ram_byte, X::RAX);
+		emitNZ(X::RAX);
+		break;
+
+	case INC: case DEC:
+		if (info.op == INC)
+			e.inc8(X::RAX);
+		else
+			e.dec8(X::RAX);
+		e.mov8(ram_byte, X::RAX);
+		emitNZ(X::RAX);
+		break;
+
+	case INX: case INY: case DEX: case DEY:
+	{
+		const Mem& reg = (info.op == INX || info.op == DEX) ? reg_X : reg_Y;
+		if (info.op == INX || info.op == INY)
+			e.inc8(reg);
+		else
+			e.dec8(reg);
+		e.movzx8(X::RAX, reg);
+		emitNZ(X::RAX);
+		break;
+	}
+
+	case TAX: case TAY: case TSX: case TXA: case TYA: case TXS:
+	{
+		const Mem& src = (info.op == TAX || info.op == TAY) ? reg_A : info.op == TSX ? reg_SP
+			: (info.op == TYA) ? reg_Y : reg_X;
+		const Mem& dst = info.op == TAX || info.op == TSX ? reg_X : info.op == TAY ? reg_Y
+			: info.op == TXS ? reg_SP : reg_A;
+		e.movzx8(X::RAX, src);
+		e.mov8(dst, X::RAX);
+		if (info.op != TXS)
+			emitNZ(X::RAX);
+		break;
+	}
+
+	case CLC: e.and8(reg_Status, static_cast<u8>(~carry_flag));    break;
+	case CLD: e.and8(reg_Status, static_cast<u8>(~decimal_flag));  break;
+	case CLI: e.and8(reg_Status, static_cast<u8>(~irq_flag));      break;
+	case CLV: e.and8(reg_Status, static_cast<u8>(~overflow_flag)); break;
+	case SEC: e.or8(reg_Status, carry_flag);   break;
+	case SED: e.or8(reg_Status, decimal_flag); break;
+	case SEI: e.or8(reg_Status, irq_flag);     break;
+	case NOP: break;
+
+	case PHA: case PHP:
+		e.movzx8(X::RAX, info.op == PHA ? reg_A : reg_Status);
+		if (info.op == PHP)
+			e.or32(X::RAX, break_flag);
+		e.movzx8(X::RCX, reg_SP);
+		e.mov64(X::RSI, ram);
+		e.mov8(stack, X::RAX);
+		e.dec8(reg_SP);
+		break;
+
+	case PLA: case PLP:
+		e.inc8(reg_SP);
+		e.movzx8(X::RCX, reg_SP);
+		e.mov64(X::RSI, ram);
+		e.movzx8(X::RAX, stack);
+		if (info.op == PLA)
+		{
+			e.mov8(reg_A, X::RAX);
+			emitNZ(X::RAX);
+		}
+		else
+		{
+			// the break flag is not affected and the unused bit always reads back as set
+			e.and32(X::RAX, static_cast<u8>(~break_flag));
+			e.movzx8(X::RDX, reg_Status);
+			e.and32(X::RDX, break_flag);
+			e.or32(X::RAX, X::RDX);
+			e.or32(X::RAX, unused_flag);
+			e.mov8(reg_Status, X::RAX);
+		}
+		break;
+
+	case BPL: case BMI: case BVC: case BVS: case BCC: case BCS: case BNE: case BEQ:
+	{
+		const u8 flag = (info.op == BPL || info.op == BMI) ? negative_flag
+			: (info.op == BVC || info.op == BVS) ? overflow_flag
+			: (info.op == BCC || info.op == BCS) ? carry_flag : zero_flag;
+		const bool branch_if_set = (info.op == BMI || info.op == BVS || info.op == BCS || info.op == BEQ);
+		const u16 next = pc + 2;
+		const u16 target = next + static_cast<i8>(zp);
+		const bool page_crossed = (next & 0xFF00) != (target & 0xFF00);
+
+		e.test8(reg_Status, flag);
+		const X::Label not_taken = e.jcc(branch_if_set ? X::E : X::NE);
+		e.add32(cycles, static_cast<i8>(1 + (page_crossed ? CPU6502::s_timings[opcode].penalty : 0)));
+		emitBranchTo(target);
+		e.bind(not_taken);
+		return false;
+	}
+
+	case JMP:
+		emitBranchTo(operand);
+		return true;
+
+	case JSR:
+	{
+		const u16 ret = pc + 2;
+		e.mov64(X::RSI, ram);
+		e.movzx8(X::RCX, reg_SP);
+		e.mov8(stack, static_cast<u8>(ret >> 8));
+		e.dec8(reg_SP);
+		e.movzx8(X::RCX, reg_SP);
+		e.mov8(stack, static_cast<u8>(ret));
+		e.dec8(reg_SP);
+		emitExit(e.jmp(), operand);
+		return true;
+	}
+
+	case RTS:
+		e.mov64(X::RSI, ram);
+		e.inc8(reg_SP);
+		e.movzx8(X::RCX, reg_SP);
+		e.movzx8(X::RAX, stack);
+		e.inc8(reg_SP);
+		e.movzx8(X::RCX, reg_SP);
+		e.movzx8(X::RDX, stack);
+		e.shl32(X::RDX, 8);
+		e.or32(X::RAX, X::RDX);
+		e.add32(X::RAX, 1);
+		e.and32(X::RAX, 0xFFFF);
+		e.mov32(reg_PC, X::RAX);
+		e.jmp(epilogue_);
+		return true;
+
+	default:
+		assert(false);
+		break;
+	}
+	return false;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CodeBuffer.hpp"
+#include "X64Emitter.hpp"
+#include "../common/type.hpp"
+
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class Bus;
+class CPU6502;
+
+// Translates hot straight-line runs of PRG ROM code into x86-64. A translated
+// block runs the instructions back to back at the fetch of its first one; the
+// caller then idles the CPU for the cycles the block consumed. Every block
+// stops before an instruction that would touch anything but internal RAM or
+// cartridge reads (PPU/APU/controller registers, mapper writes), so those still
+// go through the interpreter at their exact cycle. The block also stops once it
+// runs out of the cycle budget given by the bus, which ends before the next
+// point where an interrupt could be raised.
+class JIT6502
+{
+public:
+	explicit JIT6502(Bus& bus);
+
+	static bool supported(); // whether this build can emit code for the host
+
+	struct Result
+	{
+		u32 cycles = 0;
+		u32 instructions = 0;
+	};
+
+	// Runs the block at the CPU's PC, translating it first if it became hot.
+	// Returns zero cycles if nothing ran.
+	Result run(CPU6502& cpu, u32 budget);
+
+	void flush();
+
+	// never translate the block at pc again
+	void reject(u16 pc);
+
+	// state shared with the translated code
+	struct Context
+	{
+		u8 A = 0;
+		u8 X = 0;
+		u8 Y = 0;
+		u8 SP = 0;
+		u8 Status = 0;
+		u32 PC = 0;
+		u32 cycles = 0;
+		u32 budget = 0;
+		u32 instructions = 0;
+		u8* ram = nullptr;
+		CPU6502* cpu = nullptr;
+		std::array<u8, 256> nz{}; // negative and zero flags of a result
+	};
+
+private:
+	using Block = void (*)(Context*);
+
+	struct Entry
+	{
+		Block block = nullptr;
+		u32 generation = 0;
+		u16 hits = 0;
+		bool rejected = false;
+	};
+
+	static constexpr u16 hot_threshold = 32;
+	static constexpr usize max_block_instrs = 64;
+	static constexpr usize max_block_bytes = 16 * 1024;
+	static constexpr usize code_buffer_size = 4 * 1024 * 1024;
+
+	Entry& entry(u16 pc);
+
+	bool translatable(u8 opcode, u16 operand) const;
+	Block translate(u16 pc);
+	bool emitInstruction(u16 pc, u8 opcode, u16 operand); // true if the block ends here
+	void emitBudgetCheck(u16 pc);
+	void emitAccount(u8 opcode);
+	void emitPenalty(u8 opcode, const X64Emitter::Mem& index);
+	void emitNZ(X64Emitter::Reg value);
+	void emitExit(X64Emitter::Label label, u16 pc);
+	void emitBranchTo(u16 target);
+	void emitCallRead();
+
+	static u32 readMemory(Context* ctx, u32 addr);
+
+	Bus& bus_;
+
+	std::unique_ptr<CodeBuffer> code_;
+	X64Emitter emitter_;
+	usize epilogue_ = 0;
+
+	// pc -> offset of the budget check in front of each instruction of the
+	// block being translated, so backward branches can stay in native code
+	std::vector<std::pair<u16, usize>> instr_offsets_;
+	std::vector<std::pair<X64Emitter::Label, u16>> exits_;
+
+	std::vector<Entry> entries_; // indexed by pc - $8000
+	u32 generation_ = 1;
+	u32 bank_generation_ = 0;
+
+	Context ctx_;
+};
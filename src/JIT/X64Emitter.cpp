@@ -0,0 +1,411 @@
+#include "X64Emitter.hpp"
+
+#include <cassert>
+#include <cstring>
+
+
+void X64Emitter::setBuffer(u8* const code, const usize capacity)
+{
+	code_ = code;
+	capacity_ = capacity;
+	start_ = pos_ = 0;
+}
+
+u8* X64Emitter::begin() const
+{
+	return code_ + start_;
+}
+
+usize X64Emitter::size() const
+{
+	return pos_ - start_;
+}
+
+usize X64Emitter::remaining() const
+{
+	return capacity_ - pos_;
+}
+
+void X64Emitter::commit()
+{
+	start_ = pos_;
+}
+
+void X64Emitter::rollback()
+{
+	pos_ = start_;
+}
+
+void X64Emitter::byte(const u8 b)
+{
+	assert(pos_ < capacity_);
+	code_[pos_++] = b;
+}
+
+void X64Emitter::dword(const u32 d)
+{
+	assert(pos_ + 4 <= capacity_);
+	std::memcpy(code_ + pos_, &d, 4);
+	pos_ += 4;
+}
+
+void X64Emitter::qword(const u64 q)
+{
+	assert(pos_ + 8 <= capacity_);
+	std::memcpy(code_ + pos_, &q, 8);
+	pos_ += 8;
+}
+
+void X64Emitter::modrm(const u8 reg, const Mem& mem)
+{
+	assert(mem.base != RSP);
+	if (mem.has_index)
+	{
+		assert(mem.index != RSP);
+		byte(0x80 | (reg << 3) | 0x04);
+		byte((mem.index << 3) | mem.base);
+	}
+	else
+	{
+		byte(0x80 | (reg << 3) | mem.base);
+	}
+	dword(static_cast<u32>(mem.disp));
+}
+
+void X64Emitter::modrm(const u8 reg, const Reg rm)
+{
+	byte(0xC0 | (reg << 3) | rm);
+}
+
+void X64Emitter::movzx8(const Reg dst, const Mem& src)
+{
+	byte(0x0F); byte(0xB6); modrm(dst, src);
+}
+
+void X64Emitter::movzx8(const Reg dst, const Reg src)
+{
+	assert(src < RSP);
+	byte(0x0F); byte(0xB6); modrm(dst, src);
+}
+
+void X64Emitter::mov8(const Mem& dst, const Reg src)
+{
+	assert(src < RSP);
+	byte(0x88); modrm(src, dst);
+}
+
+void X64Emitter::mov8(const Reg dst, const Mem& src)
+{
+	assert(dst < RSP);
+	byte(0x8A); modrm(dst, src);
+}
+
+void X64Emitter::mov8(const Mem& dst, const u8 imm)
+{
+	byte(0xC6); modrm(0, dst); byte(imm);
+}
+
+void X64Emitter::mov32(const Reg dst, const Mem& src)
+{
+	byte(0x8B); modrm(dst, src);
+}
+
+void X64Emitter::mov32(const Mem& dst, const Reg src)
+{
+	byte(0x89); modrm(src, dst);
+}
+
+void X64Emitter::mov32(const Mem& dst, const u32 imm)
+{
+	byte(0xC7); modrm(0, dst); dword(imm);
+}
+
+void X64Emitter::mov32(const Reg dst, const u32 imm)
+{
+	byte(0xB8 + dst); dword(imm);
+}
+
+void X64Emitter::mov32(const Reg dst, const Reg src)
+{
+	byte(0x89); modrm(src, dst);
+}
+
+void X64Emitter::mov64(const Reg dst, const Mem& src)
+{
+	byte(0x48); byte(0x8B); modrm(dst, src);
+}
+
+void X64Emitter::mov64(const Reg dst, const Reg src)
+{
+	byte(0x48); byte(0x89); modrm(src, dst);
+}
+
+void X64Emitter::mov64(const Reg dst, const u64 imm)
+{
+	byte(0x48); byte(0xB8 + dst); qword(imm);
+}
+
+void X64Emitter::add32(const Mem& dst, const i8 imm)
+{
+	byte(0x83); modrm(0, dst); byte(static_cast<u8>(imm));
+}
+
+void X64Emitter::add32(const Reg dst, const u32 imm)
+{
+	byte(0x81); modrm(0, dst); dword(imm);
+}
+
+void X64Emitter::add32(const Reg dst, const Reg src)
+{
+	byte(0x01); modrm(src, dst);
+}
+
+void X64Emitter::and32(const Reg dst, const u32 imm)
+{
+	byte(0x81); modrm(4, dst); dword(imm);
+}
+
+void X64Emitter::or32(const Reg dst, const Reg src)
+{
+	byte(0x09); modrm(src, dst);
+}
+
+void X64Emitter::or32(const Reg dst, const u32 imm)
+{
+	byte(0x81); modrm(1, dst); dword(imm);
+}
+
+void X64Emitter::xor32(const Reg dst, const Reg src)
+{
+	byte(0x31); modrm(src, dst);
+}
+
+void X64Emitter::xor32(const Reg dst, const u32 imm)
+{
+	byte(0x81); modrm(6, dst); dword(imm);
+}
+
+void X64Emitter::cmp32(const Reg lhs, const u32 imm)
+{
+	byte(0x81); modrm(7, lhs); dword(imm);
+}
+
+void X64Emitter::cmp32(const Reg lhs, const Mem& rhs)
+{
+	byte(0x3B); modrm(lhs, rhs);
+}
+
+void X64Emitter::test32(const Reg lhs, const u32 imm)
+{
+	byte(0xF7); modrm(0, lhs); dword(imm);
+}
+
+void X64Emitter::shl32(const Reg dst, const u8 count)
+{
+	byte(0xC1); modrm(4, dst); byte(count);
+}
+
+void X64Emitter::shr32(const Reg dst, const u8 count)
+{
+	byte(0xC1); modrm(5, dst); byte(count);
+}
+
+void X64Emitter::and8(const Mem& dst, const u8 imm)
+{
+	byte(0x80); modrm(4, dst); byte(imm);
+}
+
+void X64Emitter::or8(const Mem& dst, const u8 imm)
+{
+	byte(0x80); modrm(1, dst); byte(imm);
+}
+
+void X64Emitter::or8(const Mem& dst, const Reg src)
+{
+	assert(src < RSP);
+	byte(0x08); modrm(src, dst);
+}
+
+void X64Emitter::test8(const Mem& lhs, const u8 imm)
+{
+	byte(0xF6); modrm(0, lhs); byte(imm);
+}
+
+void X64Emitter::test8(const Mem& lhs, const Reg rhs)
+{
+	assert(rhs < RSP);
+	byte(0x84); modrm(rhs, lhs);
+}
+
+void X64Emitter::add8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x00); modrm(src, dst);
+}
+
+void X64Emitter::adc8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x10); modrm(src, dst);
+}
+
+void X64Emitter::sub8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x28); modrm(src, dst);
+}
+
+void X64Emitter::cmp8(const Reg lhs, const Reg rhs)
+{
+	assert(lhs < RSP && rhs < RSP);
+	byte(0x38); modrm(rhs, lhs);
+}
+
+void X64Emitter::and8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x20); modrm(src, dst);
+}
+
+void X64Emitter::or8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x08); modrm(src, dst);
+}
+
+void X64Emitter::xor8(const Reg dst, const Reg src)
+{
+	assert(dst < RSP && src < RSP);
+	byte(0x30); modrm(src, dst);
+}
+
+void X64Emitter::not8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xF6); modrm(2, dst);
+}
+
+void X64Emitter::inc8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xFE); modrm(0, dst);
+}
+
+void X64Emitter::dec8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xFE); modrm(1, dst);
+}
+
+void X64Emitter::inc8(const Mem& dst)
+{
+	byte(0xFE); modrm(0, dst);
+}
+
+void X64Emitter::dec8(const Mem& dst)
+{
+	byte(0xFE); modrm(1, dst);
+}
+
+void X64Emitter::shl8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xD0); modrm(4, dst);
+}
+
+void X64Emitter::shr8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xD0); modrm(5, dst);
+}
+
+void X64Emitter::rcl8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xD0); modrm(2, dst);
+}
+
+void X64Emitter::rcr8(const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0xD0); modrm(3, dst);
+}
+
+void X64Emitter::setcc(const Cond cond, const Reg dst)
+{
+	assert(dst < RSP);
+	byte(0x0F); byte(0x90 + cond); modrm(0, dst);
+}
+
+X64Emitter::Label X64Emitter::jcc(const Cond cond)
+{
+	byte(0x0F); byte(0x80 + cond);
+	const Label label = pos_;
+	dword(0);
+	return label;
+}
+
+X64Emitter::Label X64Emitter::jmp()
+{
+	byte(0xE9);
+	const Label label = pos_;
+	dword(0);
+	return label;
+}
+
+void X64Emitter::rel32To(const usize target)
+{
+	dword(static_cast<u32>(static_cast<i32>(target - (pos_ + 4))));
+}
+
+void X64Emitter::jcc(const Cond cond, const usize target)
+{
+	byte(0x0F); byte(0x80 + cond); rel32To(target);
+}
+
+void X64Emitter::jmp(const usize target)
+{
+	byte(0xE9); rel32To(target);
+}
+
+void X64Emitter::bind(const Label label)
+{
+	const i32 rel = static_cast<i32>(pos_ - (label + 4));
+	std::memcpy(code_ + label, &rel, 4);
+}
+
+usize X64Emitter::here() const
+{
+	return pos_;
+}
+
+void X64Emitter::call(const void* fn)
+{
+	mov64(RAX, reinterpret_cast<u64>(fn));
+	byte(0xFF); modrm(2, RAX);
+}
+
+void X64Emitter::push(const Reg reg)
+{
+	byte(0x50 + reg);
+}
+
+void X64Emitter::pop(const Reg reg)
+{
+	byte(0x58 + reg);
+}
+
+void X64Emitter::subRsp(const u8 imm)
+{
+	byte(0x48); byte(0x83); modrm(5, RSP); byte(imm);
+}
+
+void X64Emitter::addRsp(const u8 imm)
+{
+	byte(0x48); byte(0x83); modrm(0, RSP); byte(imm);
+}
+
+void X64Emitter::ret()
+{
+	byte(0xC3);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../common/type.hpp"
+
+
+// Just enough of an x86-64 assembler for the 6502 recompiler. Only the eight
+// legacy registers are encodable and every memory operand is [base + disp32]
+// or [base + index + disp32].
+class X64Emitter
+{
+public:
+	enum Reg : u8
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI
+	};
+
+	enum Cond : u8
+	{
+		O = 0x0, NO = 0x1, B = 0x2, AE = 0x3, E = 0x4, NE = 0x5, BE = 0x6, A = 0x7,
+		S = 0x8, NS = 0x9, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF
+	};
+
+	struct Mem
+	{
+		Reg base;
+		i32 disp = 0;
+		bool has_index = false;
+		Reg index = RAX;
+	};
+
+	static constexpr Mem at(Reg base, i32 disp) { return { base, disp }; }
+	static constexpr Mem at(Reg base, Reg index, i32 disp = 0) { return { base, disp, true, index }; }
+
+	using Label = usize; // offset of a rel32 waiting to be patched
+
+	void setBuffer(u8* code, usize capacity);
+
+	u8* begin() const; // start of the code emitted since the last setBuffer/commit
+	usize size() const;
+	usize remaining() const;
+	void commit();
+	void rollback(); // drop the code emitted since the last commit
+
+	// moves
+	void movzx8(Reg dst, const Mem& src);  // movzx r32, byte [m]
+	void movzx8(Reg dst, Reg src);         // movzx r32, r8
+	void mov8(const Mem& dst, Reg src);    // mov byte [m], r8
+	void mov8(Reg dst, const Mem& src);    // mov r8, byte [m]
+	void mov8(const Mem& dst, u8 imm);     // mov byte [m], imm8
+	void mov32(Reg dst, const Mem& src);
+	void mov32(const Mem& dst, Reg src);
+	void mov32(const Mem& dst, u32 imm);
+	void mov32(Reg dst, u32 imm);
+	void mov32(Reg dst, Reg src);
+	void mov64(Reg dst, const Mem& src);
+	void mov64(Reg dst, Reg src);
+	void mov64(Reg dst, u64 imm);
+
+	// arithmetic
+	void add32(const Mem& dst, i8 imm);
+	void add32(Reg dst, u32 imm);
+	void add32(Reg dst, Reg src);
+	void and32(Reg dst, u32 imm);
+	void or32(Reg dst, Reg src);
+	void or32(Reg dst, u32 imm);
+	void xor32(Reg dst, Reg src);
+	void xor32(Reg dst, u32 imm);
+	void cmp32(Reg lhs, u32 imm);
+	void cmp32(Reg lhs, const Mem& rhs);
+	void test32(Reg lhs, u32 imm);
+	void shl32(Reg dst, u8 count);
+	void shr32(Reg dst, u8 count);
+	void and8(const Mem& dst, u8 imm);
+	void or8(const Mem& dst, u8 imm);
+	void or8(const Mem& dst, Reg src);
+	void test8(const Mem& lhs, u8 imm);
+	void test8(const Mem& lhs, Reg rhs);
+	void add8(Reg dst, Reg src);
+	void adc8(Reg dst, Reg src);
+	void sub8(Reg dst, Reg src);
+	void cmp8(Reg lhs, Reg rhs);
+	void and8(Reg dst, Reg src);
+	void or8(Reg dst, Reg src);
+	void xor8(Reg dst, Reg src);
+	void not8(Reg dst);
+	void inc8(Reg dst);
+	void dec8(Reg dst);
+	void inc8(const Mem& dst);
+	void dec8(const Mem& dst);
+	void shl8(Reg dst); // all four shift/rotate by one
+	void shr8(Reg dst);
+	void rcl8(Reg dst);
+	void rcr8(Reg dst);
+	void setcc(Cond cond, Reg dst);
+
+	// control flow
+	Label jcc(Cond cond);
+	Label jmp();
+	void jcc(Cond cond, usize target);
+	void jmp(usize target);
+	void bind(Label label);
+	usize here() const;
+	void call(const void* fn); // clobbers rax
+	void push(Reg reg);
+	void pop(Reg reg);
+	void subRsp(u8 imm);
+	void addRsp(u8 imm);
+	void ret();
+
+private:
+	void byte(u8 b);
+	void dword(u32 d);
+	void qword(u64 q);
+	void modrm(u8 reg, const Mem& mem);
+	void modrm(u8 reg, Reg rm);
+	void rel32To(usize target);
+
+	u8* code_ = nullptr;
+	usize capacity_ = 0;
+	usize start_ = 0;
+	usize pos_ = 0;
+};
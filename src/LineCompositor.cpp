@@ -0,0 +1,197 @@
+#include "LineCompositor.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LINE_COMPOSITOR_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+
+namespace
+{
+	constexpr unsigned line_width = 256;
+
+	void composeBackgroundScalar(const u8* const stream, const unsigned fine_x, const unsigned first_x, u8* const pixels, u8* const opaque)
+	{
+		for (unsigned x = 0; x < line_width; ++x)
+		{
+			const u8 pixel = stream[fine_x + x];
+			const bool visible = (pixel & 0x03) != 0 && x >= first_x;
+			pixels[x] = visible ? pixel : 0;
+			opaque[x] = visible ? 0xFF : 0x00;
+		}
+	}
+
+	bool mergeSpritesScalar(const u8* const bg, const u8* const bg_opaque, const u8* const sp, const u8* const sp_behind, const u8* const sp_zero, u8* const out)
+	{
+		u8 hit = 0;
+		for (unsigned x = 0; x < line_width; ++x)
+		{
+			const u8 sp_opaque = (sp[x] != 0) ? 0xFF : 0x00;
+			const u8 show_sp = sp_opaque & ~(sp_behind[x] & bg_opaque[x]);
+			out[x] = show_sp ? (0x10 | sp[x]) : bg[x];
+			hit |= bg_opaque[x] & sp_opaque & sp_zero[x];
+		}
+		return hit != 0;
+	}
+
+#ifdef LINE_COMPOSITOR_X86
+	TARGET("sse4.1")
+	void composeBackgroundSSE41(const u8* const stream, const unsigned fine_x, const unsigned first_x, u8* const pixels, u8* const opaque)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i pat_mask = _mm_set1_epi8(0x03);
+		const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		const __m128i left = _mm_cmpgt_epi8(lanes, _mm_set1_epi8(static_cast<char>(first_x) - 1));
+		for (unsigned x = 0; x < line_width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stream + fine_x + x));
+			const __m128i transparent = _mm_cmpeq_epi8(_mm_and_si128(v, pat_mask), zero);
+			__m128i visible = _mm_andnot_si128(transparent, _mm_set1_epi8(-1));
+			if (x == 0)
+			{
+				visible = _mm_and_si128(visible, left);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x), _mm_and_si128(v, visible));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(opaque + x), visible);
+		}
+	}
+
+	TARGET("sse4.1")
+	bool mergeSpritesSSE41(const u8* const bg, const u8* const bg_opaque, const u8* const sp, const u8* const sp_behind, const u8* const sp_zero, u8* const out)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i sprite_bit = _mm_set1_epi8(0x10);
+		__m128i hit = zero;
+		for (unsigned x = 0; x < line_width; x += 16)
+		{
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+			const __m128i b_opaque = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg_opaque + x));
+			const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sp + x));
+			const __m128i s_behind = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sp_behind + x));
+			const __m128i s_zero = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sp_zero + x));
+			const __m128i s_opaque = _mm_andnot_si128(_mm_cmpeq_epi8(s, zero), _mm_set1_epi8(-1));
+			const __m128i show_sp = _mm_andnot_si128(_mm_and_si128(s_behind, b_opaque), s_opaque);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_blendv_epi8(b, _mm_or_si128(s, sprite_bit), show_sp));
+			hit = _mm_or_si128(hit, _mm_and_si128(_mm_and_si128(b_opaque, s_opaque), s_zero));
+		}
+		return _mm_movemask_epi8(hit) != 0;
+	}
+
+	TARGET("avx2")
+	void composeBackgroundAVX2(const u8* const stream, const unsigned fine_x, const unsigned first_x, u8* const pixels, u8* const opaque)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i pat_mask = _mm256_set1_epi8(0x03);
+		const __m256i lanes = _mm256_setr_epi8(
+			0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+			16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+		const __m256i left = _mm256_cmpgt_epi8(lanes, _mm256_set1_epi8(static_cast<char>(first_x) - 1));
+		for (unsigned x = 0; x < line_width; x += 32)
+		{
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stream + fine_x + x));
+			const __m256i transparent = _mm256_cmpeq_epi8(_mm256_and_si256(v, pat_mask), zero);
+			__m256i visible = _mm256_andnot_si256(transparent, _mm256_set1_epi8(-1));
+			if (x == 0)
+			{
+				visible = _mm256_and_si256(visible, left);
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x), _mm256_and_si256(v, visible));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(opaque + x), visible);
+		}
+	}
+
+	TARGET("avx2")
+	bool mergeSpritesAVX2(const u8* const bg, const u8* const bg_opaque, const u8* const sp, const u8* const sp_behind, const u8* const sp_zero, u8* const out)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i sprite_bit = _mm256_set1_epi8(0x10);
+		__m256i hit = zero;
+		for (unsigned x = 0; x < line_width; x += 32)
+		{
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x));
+			const __m256i b_opaque = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg_opaque + x));
+			const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sp + x));
+			const __m256i s_behind = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sp_behind + x));
+			const __m256i s_zero = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sp_zero + x));
+			const __m256i s_opaque = _mm256_andnot_si256(_mm256_cmpeq_epi8(s, zero), _mm256_set1_epi8(-1));
+			const __m256i show_sp = _mm256_andnot_si256(_mm256_and_si256(s_behind, b_opaque), s_opaque);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_blendv_epi8(b, _mm256_or_si256(s, sprite_bit), show_sp));
+			hit = _mm256_or_si256(hit, _mm256_and_si256(_mm256_and_si256(b_opaque, s_opaque), s_zero));
+		}
+		return _mm256_movemask_epi8(hit) != 0;
+	}
+
+	bool hostHasSSE41()
+	{
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 1);
+		return (regs[2] & (1 << 19)) != 0;
+#else
+		return __builtin_cpu_supports("sse4.1");
+#endif
+	}
+
+	bool hostHasAVX2()
+	{
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 1);
+		const bool os_saves_ymm = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x06) == 0x06;
+		__cpuidex(regs, 7, 0);
+		return os_saves_ymm && (regs[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	struct Backend
+	{
+		const char* name;
+		void (*compose_background)(const u8*, unsigned, unsigned, u8*, u8*);
+		bool (*merge_sprites)(const u8*, const u8*, const u8*, const u8*, const u8*, u8*);
+	};
+
+	Backend pickBackend()
+	{
+#ifdef LINE_COMPOSITOR_X86
+		if (hostHasAVX2())
+		{
+			return { "avx2", composeBackgroundAVX2, mergeSpritesAVX2 };
+		}
+		if (hostHasSSE41())
+		{
+			return { "sse4.1", composeBackgroundSSE41, mergeSpritesSSE41 };
+		}
+#endif
+		return { "scalar", composeBackgroundScalar, mergeSpritesScalar };
+	}
+
+	const Backend& backend()
+	{
+		static const Backend picked = pickBackend();
+		return picked;
+	}
+}
+
+void LineCompositor::composeBackground(const u8* const stream, const unsigned fine_x, const unsigned first_x, u8* const pixels, u8* const opaque)
+{
+	backend().compose_background(stream, fine_x, first_x, pixels, opaque);
+}
+
+bool LineCompositor::mergeSprites(const u8* const bg, const u8* const bg_opaque, const u8* const sp, const u8* const sp_behind, const u8* const sp_zero, u8* const out)
+{
+	return backend().merge_sprites(bg, bg_opaque, sp, sp_behind, sp_zero, out);
+}
+
+const char* LineCompositor::backendName()
+{
+	return backend().name;
+}
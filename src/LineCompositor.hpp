@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pch.hpp"
+
+
+// The data parallel part of drawing a scanline. Every function works on 256
+// pixels of palette RAM addresses (sprite << 4 | pal << 2 | pat) and picks
+// an AVX2, SSE4.1 or scalar version for the host the first time it is used.
+namespace LineCompositor
+{
+	// Background pixel x is stream[fine_x + x]. Writes the 256 pixels with the
+	// transparent ones and the ones left of first_x set to 0, and 0xFF to
+	// opaque[x] for every pixel left visible. stream holds at least 263 bytes.
+	void composeBackground(const u8* stream, unsigned fine_x, unsigned first_x, u8* pixels, u8* opaque);
+
+	// Puts the sprite pixels (pal << 2 | pat, 0 where there is none) over or
+	// behind the background. Returns whether sprite 0 overlaps an opaque
+	// background pixel.
+	bool mergeSprites(const u8* bg, const u8* bg_opaque, const u8* sp, const u8* sp_behind, const u8* sp_zero, u8* out);
+
+	const char* backendName();
+}
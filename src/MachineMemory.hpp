@@ -0,0 +1,29 @@
+#pragma once
+
+#include "pch.hpp"
+#include "Cartridge.hpp"
+
+#include <type_traits>
+
+
+// Every byte of memory the emulated console can write, in one block owned by
+// the bus. Nothing in it points anywhere, so copying it is a snapshot: the
+// page tables that point into it are derived from the mapper bank registers,
+// which are offsets.
+struct MachineMemory
+{
+	static constexpr usize ram_size = 2_KB;
+	static constexpr usize vram_size = 4_KB; // four screen; 2KB of it otherwise
+	static constexpr usize oam_size = 256;
+	static constexpr usize palette_size = 32;
+	static constexpr usize prg_ram_size = 8_KB;
+	static constexpr usize chr_ram_size = 8_KB;
+
+	std::array<u8, ram_size> ram{};         // CPU $0000-$07FF
+	std::array<u8, vram_size> vram{};       // nametables
+	std::array<u8, oam_size> oam{};
+	std::array<u8, palette_size> palette{}; // $3F00-$3F1F
+	std::array<u8, prg_ram_size> prg_ram{}; // cartridge $6000-$7FFF
+	std::array<u8, chr_ram_size> chr_ram{}; // used if the cartridge has no CHR ROM
+};
+static_assert(std::is_trivially_copyable_v<MachineMemory>);
@@ -1,4 +1,5 @@
 #include "Mapper.hpp"
+#include "../StateArchive.hpp"
 
 
 Mapper::Mapper(Cartridge cart) : 
@@ -6,11 +7,167 @@ Mapper::Mapper(Cartridge cart) :
 {
 }
 
-MirrorType Mapper::getMirrorType()
+MirrorType Mapper::getMirrorType() const
 {
 	return cart_.mirror_type;
 }
 
+u8* const Mapper::PRGRom()
+{
+	return cart_.PRGRom();
+}
+
+u8* const Mapper::CHRMem()
+{
+	return cart_.useCHRRam() ? memory_->chr_ram.data() : cart_.CHRMem();
+}
+
+u8* Mapper::prgRAM()
+{
+	return memory_->prg_ram.data();
+}
+
+void Mapper::attachMemory(MachineMemory& memory)
+{
+	memory_ = &memory;
+}
+
+usize Mapper::CHRMemSize() const
+{
+	return cart_.CHRMemSize();
+}
+
+bool Mapper::useCHRRam() const
+{
+	return cart_.useCHRRam();
+}
+
+u64 Mapper::romHash() const
+{
+	return cart_.romHash();
+}
+
+void Mapper::serialize(StateArchive& ar)
+{
+	ar(cart_.mirror_type, irq);
+	serializeBanks(ar);
+	if (ar.loading())
+	{
+		prgBankSwitched();
+		chrBankSwitched();
+	}
+}
+
+u32 Mapper::prgBankGeneration() const
+{
+	return prg_bank_generation_;
+}
+
+u32 Mapper::chrBankGeneration() const
+{
+	return chr_bank_generation_;
+}
+
+u8* Mapper::chrPtr(const u16 addr)
+{
+	return &CHRMem()[addr];
+}
+
+void Mapper::mapCPUPages(CPUPage* const pages)
+{
+	cpu_pages_ = pages;
+	remapCPUPages();
+}
+
+CPUPage Mapper::cpuPage(const u16 addr)
+{
+	return { prgRomPtr(addr), nullptr };
+}
+
+void Mapper::prgBankSwitched()
+{
+	++prg_bank_generation_;
+	remapCPUPages();
+}
+
+void Mapper::chrBankSwitched()
+{
+	++chr_bank_generation_;
+	remapPPUPages();
+}
+
+void Mapper::setMirroring(const MirrorType type)
+{
+	cart_.mirror_type = type;
+	remapPPUPages();
+}
+
+void Mapper::mapPPUPages(PPUPage* const pages, u8* const vram)
+{
+	ppu_pages_ = pages;
+	vram_ = vram;
+	remapPPUPages();
+}
+
+PPUPage Mapper::chrPage(const u16 addr)
+{
+	u8* const chr = chrPtr(addr);
+	return { chr, cart_.useCHRRam() ? chr : nullptr };
+}
+
+void Mapper::remapPPUPages()
+{
+	if (ppu_pages_ == nullptr)
+	{
+		return;
+	}
+	for (usize i = 0; i < 0x2000 / PPUPage::size; i++)
+	{
+		ppu_pages_[i] = chrPage(static_cast<u16>(i * PPUPage::size));
+	}
+	// $3000-$3EFF mirrors $2000-$2EFF
+	for (usize i = 0x2000 / PPUPage::size; i < PPUPage::count; i++)
+	{
+		const usize nametable = i & 0x03;
+		usize bank = nametable;
+		switch (cart_.mirror_type)
+		{
+		case MirrorType::Vertical:
+			bank = nametable & 0x01;
+			break;
+
+		case MirrorType::Horizontal:
+			bank = nametable >> 1;
+			break;
+
+		case MirrorType::OneScreenLow:
+			bank = 0;
+			break;
+
+		case MirrorType::OneScreenHigh:
+			bank = 3;
+			break;
+
+		case MirrorType::FourScreen:
+			break;
+		}
+		u8* const page = vram_ + bank * PPUPage::size;
+		ppu_pages_[i] = { page, page };
+	}
+}
+
+void Mapper::remapCPUPages()
+{
+	if (cpu_pages_ == nullptr)
+	{
+		return;
+	}
+	for (usize i = 0x6000 / CPUPage::size; i < CPUPage::count; i++)
+	{
+		cpu_pages_[i] = cpuPage(static_cast<u16>(i * CPUPage::size));
+	}
+}
+
 std::shared_ptr<Mapper> createMapper()
 {
 	return nullptr;
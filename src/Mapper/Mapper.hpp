@@ -1,10 +1,36 @@
 #pragma once
 
 #include "../Cartridge.hpp"
+#include "../MachineMemory.hpp"
 
 #include <memory>
 #include <optional>
 
+class StateArchive;
+
+
+// One 1KB page of the CPU address space. Plain memory is accessed straight
+// through the pointers; a null pointer sends the access to the page's handler.
+struct CPUPage
+{
+	static constexpr u16 size = 0x0400;
+	static constexpr usize count = 64;
+
+	const u8* read = nullptr;
+	u8* write = nullptr;
+};
+
+// One 1KB page of the PPU address space: CHR at $0000-$1FFF and the
+// nametables at $2000-$3FFF. A null write pointer ignores the write. The
+// palette at $3F00-$3FFF is not part of it.
+struct PPUPage
+{
+	static constexpr u16 size = 0x0400;
+	static constexpr usize count = 16;
+
+	const u8* read = nullptr;
+	u8* write = nullptr;
+};
 
 class Mapper
 {
@@ -15,15 +41,73 @@ public:
 	virtual bool cpuMapWrite(u16, u8) { return false; }
 	virtual std::optional<u8> cpuMapRead(u16) { return false; }
 	
-	virtual bool ppuMapWrite(u16, u8) { return false; }
-	virtual std::optional<u8> ppuMapRead(u16) { return false; }
+	// the PRG ROM byte the CPU sees at addr, nullptr if addr is not mapped to PRG ROM
+	virtual const u8* prgRomPtr(u16) { return nullptr; }
+
+	// the CHR byte the PPU sees at addr ($0000-$1FFF)
+	virtual u8* chrPtr(u16 addr);
 
 	virtual void updateIRQCounter() {};
 
-	MirrorType getMirrorType();
+	// The console memory that holds the PRG RAM and CHR RAM. Set before
+	// anything is mapped.
+	void attachMemory(MachineMemory& memory);
+
+	// Mirroring, IRQ and the bank registers; PRG RAM and CHR RAM are part of
+	// MachineMemory. Loading remaps every page.
+	void serialize(StateArchive& ar);
+
+	// Backs the cartridge pages ($6000-$FFFF) of the CPU page table with the
+	// memory currently banked in. They are re-pointed on every bank switch.
+	void mapCPUPages(CPUPage* pages);
+
+	// Fills the PPU page table: CHR banks and the nametable layout over the
+	// 4KB of nametable RAM at vram. Updated on every CHR bank or mirroring
+	// change.
+	void mapPPUPages(PPUPage* pages, u8* vram);
+
+	MirrorType getMirrorType() const;
+
+	u8* const PRGRom();
+	u8* const CHRMem(); // CHR ROM, or the CHR RAM in the attached memory
+	usize CHRMemSize() const;
+	bool useCHRRam() const;
+
+	// FNV-1a of PRG and CHR ROM, see Cartridge::romHash
+	u64 romHash() const;
+
+	// changes every time the CPU address -> PRG ROM mapping changes
+	u32 prgBankGeneration() const;
+
+	// changes every time the PPU address -> CHR mapping changes
+	u32 chrBankGeneration() const;
 
 	bool irq = false;
 
 protected:
+	virtual void serializeBanks(StateArchive&) {}
+
+	// the pointers for the page at addr ($6000-$FFFF), read-only PRG ROM by default
+	virtual CPUPage cpuPage(u16 addr);
+
+	// the pointers for the CHR page at addr ($0000-$1FFF), writable if the cart has CHR RAM
+	virtual PPUPage chrPage(u16 addr);
+
+	void prgBankSwitched();
+	void remapCPUPages();
+	void chrBankSwitched();
+	void setMirroring(MirrorType type);
+	void remapPPUPages();
+
+	u8* prgRAM(); // 8KB
+
 	Cartridge cart_;
+
+private:
+	u32 prg_bank_generation_ = 0;
+	u32 chr_bank_generation_ = 0;
+	MachineMemory* memory_ = nullptr;
+	CPUPage* cpu_pages_ = nullptr;
+	PPUPage* ppu_pages_ = nullptr;
+	u8* vram_ = nullptr;
 };
\ No newline at end of file
@@ -10,7 +10,5 @@ public:
 	~Mapper000() override = default;
 
 	std::optional<u8> cpuMapRead(u16 addr) override;
-
-	bool ppuMapWrite(u16 addr, u8 data) override;
-	std::optional<u8> ppuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 };
\ No newline at end of file
@@ -1,11 +1,11 @@
 #include "Mapper001.hpp"
+#include "../StateArchive.hpp"
 #include "../common/bitHelper.hpp"
 
 
 
 Mapper001::Mapper001(Cartridge cart) :
-	Mapper{ std::move(cart) },
-	prg_ram_(8_KB)
+	Mapper{ std::move(cart) }
 {
 	nprg_banks_ = cart_.PRGRomSize() / 16_KB;
 }
@@ -19,7 +19,7 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 
 	if (addr < 0x8000)
 	{
-		prg_ram_[addr & 0x1FFF] = data;
+		prgRAM()[addr & 0x1FFF] = data;
 		return true;
 	}
 
@@ -28,6 +28,7 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 		shift_reg_ = 0x10;
 		prg_bank_mode_ = 3;
 		prg16_bank_high_ = nprg_banks_ - 1;
+		prgBankSwitched();
 		return true;
 	}
 
@@ -44,19 +45,19 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 		switch (cmd & 0x03)
 		{
 		case 0:
-			cart_.mirror_type = MirrorType::OneScreenLow;
+			setMirroring(MirrorType::OneScreenLow);
 			break;
 
 		case 1:
-			cart_.mirror_type = MirrorType::OneScreenHigh;
+			setMirroring(MirrorType::OneScreenHigh);
 			break;
 
 		case 2:
-			cart_.mirror_type = MirrorType::Vertical;
+			setMirroring(MirrorType::Vertical);
 			break;
 
 		case 3:
-			cart_.mirror_type = MirrorType::Horizontal;
+			setMirroring(MirrorType::Horizontal);
 			break;
 		}
 
@@ -71,6 +72,8 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 		}
 
 		chr_bank_mode_ = getBitN(cmd, 4);
+		prgBankSwitched();
+		chrBankSwitched();
 	}
 	else if (addr <= 0xBFFF)
 	{
@@ -82,6 +85,7 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 		{
 			chr8_bank_ = (cmd & 0x1E);
 		}
+		chrBankSwitched();
 	}
 	else if (addr <= 0xDFFF)
 	{
@@ -89,6 +93,7 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 		{
 			chr4_bank_high_ = (cmd & 0x1F);
 		}
+		chrBankSwitched();
 	}
 	else
 	{
@@ -106,6 +111,7 @@ bool Mapper001::cpuMapWrite(const u16 addr, const u8 data)
 			prg16_bank_low_  = (cmd & 0x0F);
 			break;
 		}
+		prgBankSwitched();
 	}
 	return true;
 }
@@ -119,46 +125,56 @@ std::optional<u8> Mapper001::cpuMapRead(const u16 addr)
 
 	if (addr < 0x8000)
 	{
-		return prg_ram_[addr & 0x1FFF];
+		return prgRAM()[addr & 0x1FFF];
 	}
-	if (prg_bank_mode_ <= 1) // 32KB mode
-	{
-		return cart_.PRGRom()[prg32_bank_ * 16_KB + (addr & 0x7FFF)];
-	}
-	if (addr < 0xC000)
-	{
-		return cart_.PRGRom()[prg16_bank_low_ * 16_KB + (addr & 0x3FFF)];
-	}
-	return cart_.PRGRom()[prg16_bank_high_ * 16_KB + (addr & 0x3FFF)];
+	return *prgRomPtr(addr);
 }
 
-bool Mapper001::ppuMapWrite(const u16 addr, const u8 data)
+CPUPage Mapper001::cpuPage(const u16 addr)
 {
-	if (cart_.useCHRRam() && addr <= 0x1FFF)
+	if (addr < 0x8000)
 	{
-		cart_.CHRMem()[addr] = data;
-		return true;
+		u8* const ram = &prgRAM()[addr & 0x1FFF];
+		return { ram, ram };
 	}
-	return false;
+	return Mapper::cpuPage(addr);
 }
 
-std::optional<u8> Mapper001::ppuMapRead(const u16 addr)
+const u8* Mapper001::prgRomPtr(const u16 addr)
 {
-	if (addr >= 0x2000)
+	if (addr < 0x8000)
 	{
-		return std::nullopt;
+		return nullptr;
 	}
+	if (prg_bank_mode_ <= 1) // 32KB mode
+	{
+		return &cart_.PRGRom()[prg32_bank_ * 16_KB + (addr & 0x7FFF)];
+	}
+	if (addr < 0xC000)
+	{
+		return &cart_.PRGRom()[prg16_bank_low_ * 16_KB + (addr & 0x3FFF)];
+	}
+	return &cart_.PRGRom()[prg16_bank_high_ * 16_KB + (addr & 0x3FFF)];
+}
+
+u8* Mapper001::chrPtr(const u16 addr)
+{
 	if (cart_.useCHRRam())
 	{
-		return cart_.CHRMem()[addr];
+		return &CHRMem()[addr];
 	}
 	if (chr_bank_mode_)
 	{
 		if (addr < 0x1000)
 		{
-			return cart_.CHRMem()[chr4_bank_low_ * 4_KB + (addr & 0x0FFF)];
+			return &CHRMem()[chr4_bank_low_ * 4_KB + (addr & 0x0FFF)];
 		}
-		return cart_.CHRMem()[chr4_bank_high_ * 4_KB + (addr & 0x0FFF)];
+		return &CHRMem()[chr4_bank_high_ * 4_KB + (addr & 0x0FFF)];
 	}
-	return cart_.CHRMem()[chr8_bank_ * 4_KB + addr];
-}
\ No newline at end of file
+	return &CHRMem()[chr8_bank_ * 4_KB + addr];
+}
+
+void Mapper001::serializeBanks(StateArchive& ar)
+{
+	ar(prg16_bank_low_, prg16_bank_high_, prg32_bank_, prg_bank_mode_, chr4_bank_low_, chr4_bank_high_, chr8_bank_, chr_bank_mode_, shift_reg_, load_reg_);
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "Mapper.hpp"
-#include <vector>
 
 
 class Mapper001 : public Mapper
@@ -12,9 +11,13 @@ public:
 
 	bool cpuMapWrite(u16 addr, u8 data) override;
 	std::optional<u8> cpuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 
-	bool ppuMapWrite(u16 addr, u8 data) override;
-	std::optional<u8> ppuMapRead(u16 addr) override;
+	u8* chrPtr(u16 addr) override;
+
+protected:
+	void serializeBanks(StateArchive& ar) override;
+	CPUPage cpuPage(u16 addr) override;
 
 private:
 	usize nprg_banks_;
@@ -28,6 +31,4 @@ private:
 	bool chr_bank_mode_ = 0;
 	
 	u8 shift_reg_ = 0x10, load_reg_ = 0;
-
-	std::vector<u8> prg_ram_;
 };
@@ -1,4 +1,5 @@
 #include "Mapper002.hpp"
+#include "../StateArchive.hpp"
 
 Mapper002::Mapper002(Cartridge cart) :
 	Mapper{ std::move(cart) }
@@ -13,37 +14,33 @@ bool Mapper002::cpuMapWrite(const u16 addr, const u8 data)
 		return false;
 	}
 	prg_low_ = (data & 0x07);
+	prgBankSwitched();
 	return true;
 }
 
 std::optional<u8> Mapper002::cpuMapRead(const u16 addr)
 {
-	if (addr < 0x8000)
-	{
-		return std::nullopt;
-	}
-	if (addr < 0xC000)
+	if (const u8* data = prgRomPtr(addr))
 	{
-		return cart_.PRGRom()[prg_low_ * 16_KB  + (addr & 0x3FFF)];
+		return *data;
 	}
-	return cart_.PRGRom()[prg_high_ * 16_KB + (addr & 0x3FFF)];
+	return std::nullopt;
 }
 
-bool Mapper002::ppuMapWrite(const u16 addr, const u8 data)
+const u8* Mapper002::prgRomPtr(const u16 addr)
 {
-	if (!cart_.useCHRRam() || addr >= 0x2000)
+	if (addr < 0x8000)
 	{
-		return false;
+		return nullptr;
 	}
-	cart_.CHRMem()[addr] = data;
-	return true;
+	if (addr < 0xC000)
+	{
+		return &cart_.PRGRom()[prg_low_ * 16_KB  + (addr & 0x3FFF)];
+	}
+	return &cart_.PRGRom()[prg_high_ * 16_KB + (addr & 0x3FFF)];
 }
 
-std::optional<u8> Mapper002::ppuMapRead(const u16 addr)
+void Mapper002::serializeBanks(StateArchive& ar)
 {
-	if (addr <= 0x1FFF)
-	{
-		return cart_.CHRMem()[addr];
-	}
-	return std::nullopt;
+	ar(prg_low_, prg_high_);
 }
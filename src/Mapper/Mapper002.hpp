@@ -11,9 +11,10 @@ public:
 
 	bool cpuMapWrite(u16 addr, u8 data) override;
 	std::optional<u8> cpuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 
-	bool ppuMapWrite(u16 addr, u8 data) override;
-	std::optional<u8> ppuMapRead(u16 addr) override;
+protected:
+	void serializeBanks(StateArchive& ar) override;
 
 private:
 	usize prg_low_ = 0;
@@ -1,4 +1,5 @@
 #include "Mapper003.hpp"
+#include "../StateArchive.hpp"
 #include <limits>
 
 
@@ -12,6 +13,7 @@ bool Mapper003::cpuMapWrite(const u16 addr, const u8 data)
 	if (!cart_.useCHRRam() && 0x8000 <= addr && addr <= 0xFFFF)
 	{
 		chr_bank_start_ = (data & 0x03) * 8_KB;
+		chrBankSwitched();
 		return true;
 	}
 	return false;
@@ -19,32 +21,32 @@ bool Mapper003::cpuMapWrite(const u16 addr, const u8 data)
 
 std::optional<u8> Mapper003::cpuMapRead(const u16 addr)
 {
-	if (0x8000 <= addr && addr <= 0xFFFF)
+	if (const u8* data = prgRomPtr(addr))
 	{
-		return cart_.PRGRom()[addr & (cart_.PRGRomSize() > 16_KB ? 0x7FFF : 0x3FFF)];
+		return *data;
 	}
 	return std::nullopt;
 }
 
-bool Mapper003::ppuMapWrite(const u16 addr, const u8 data)
+const u8* Mapper003::prgRomPtr(const u16 addr)
 {
-	if (cart_.useCHRRam() && addr <= 0x1FFF)
+	if (0x8000 <= addr && addr <= 0xFFFF)
 	{
-		cart_.CHRMem()[addr] = data;
-		return true;
+		return &cart_.PRGRom()[addr & (cart_.PRGRomSize() > 16_KB ? 0x7FFF : 0x3FFF)];
 	}
-	return false;
+	return nullptr;
 }
 
-std::optional<u8> Mapper003::ppuMapRead(const u16 addr)
+u8* Mapper003::chrPtr(const u16 addr)
 {
-	if (addr <= 0x1FFF)
+	if (cart_.useCHRRam())
 	{
-		if (cart_.useCHRRam())
-		{
-			return cart_.CHRMem()[addr];
-		}
-		return cart_.CHRMem()[chr_bank_start_ + addr];
+		return &CHRMem()[addr];
 	}
-	return std::nullopt;
+	return &CHRMem()[chr_bank_start_ + addr];
+}
+
+void Mapper003::serializeBanks(StateArchive& ar)
+{
+	ar(chr_bank_start_);
 }
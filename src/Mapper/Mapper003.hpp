@@ -11,9 +11,12 @@ public:
 
 	bool cpuMapWrite(u16 addr, u8 data) override;
 	std::optional<u8> cpuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 
-	bool ppuMapWrite(u16 addr, u8 data) override;
-	std::optional<u8> ppuMapRead(u16 addr) override;
+	u8* chrPtr(u16 addr) override;
+
+protected:
+	void serializeBanks(StateArchive& ar) override;
 
 private:
 	usize chr_bank_start_ = 0;
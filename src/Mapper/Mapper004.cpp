@@ -1,19 +1,15 @@
 #include "Mapper004.hpp"
+#include "../StateArchive.hpp"
 #include "../common/bitHelper.hpp"
 #include <cassert>	
 
 
 Mapper004::Mapper004(Cartridge cart) :
-	Mapper{ std::move(cart) },
-	prg_ram_(8_KB)
+	Mapper{ std::move(cart) }
 {
 	const usize prg_banks = cart_.PRGRomSize() / 8_KB;
-	fix_prg_second_last_ = &cart_.PRGRom()[(prg_banks - 2) * 8_KB];
-	fix_prg_last_ = &cart_.PRGRom()[(prg_banks - 1) * 8_KB];
-	prg_banks_[0] = prg_banks_[1] = &cart_.PRGRom()[0];
-	chr_2kbanks_[0] = chr_2kbanks_[1] = &cart_.CHRMem()[0];
-	chr_1kbanks_[0] = chr_1kbanks_[1] = &cart_.CHRMem()[0];
-	chr_1kbanks_[2] = chr_1kbanks_[3] = &cart_.CHRMem()[0];
+	fix_prg_second_last_ = (prg_banks - 2) * 8_KB;
+	fix_prg_last_ = (prg_banks - 1) * 8_KB;
 }
 
 bool Mapper004::cpuMapWrite(const u16 addr, const u8 data)
@@ -27,7 +23,7 @@ bool Mapper004::cpuMapWrite(const u16 addr, const u8 data)
 	{
 		if (!ram_write_protect_)
 		{
-			prg_ram_[addr & 0x1FFF] = data;
+			prgRAM()[addr & 0x1FFF] = data;
 		}
 		return true;
 	}
@@ -40,41 +36,51 @@ bool Mapper004::cpuMapWrite(const u16 addr, const u8 data)
 			bank_select_ = data & 0x07;
 			prg_bank_mode_ = getBitN(data, 6);
 			chr_bank_inversion_ = getBitN(data, 7);
+			prgBankSwitched();
+			chrBankSwitched();
 		}
 		else
 		{
 			switch (bank_select_)
 			{
 			case 0b000:
-				chr_2kbanks_[0] = &cart_.CHRMem()[(data & 0xFE) * 1_KB];
+				chr_2kbanks_[0] = (data & 0xFE) * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b001:
-				chr_2kbanks_[1] = &cart_.CHRMem()[(data & 0xFE) * 1_KB];
+				chr_2kbanks_[1] = (data & 0xFE) * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b010:
-				chr_1kbanks_[0] = &cart_.CHRMem()[data * 1_KB];
+				chr_1kbanks_[0] = data * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b011:
-				chr_1kbanks_[1] = &cart_.CHRMem()[data * 1_KB];
+				chr_1kbanks_[1] = data * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b100:
-				chr_1kbanks_[2] = &cart_.CHRMem()[data * 1_KB];
+				chr_1kbanks_[2] = data * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b101:
-				chr_1kbanks_[3] = &cart_.CHRMem()[data * 1_KB];
+				chr_1kbanks_[3] = data * 1_KB;
+				chrBankSwitched();
 				break;
 
 			case 0b110:
-				prg_banks_[0] = &cart_.PRGRom()[(data & 0x3F) * 8_KB];
+				prg_banks_[0] = (data & 0x3F) * 8_KB;
+				prgBankSwitched();
 				break;
 
 			case 0b111:
-				prg_banks_[1] = &cart_.PRGRom()[(data & 0x3F) * 8_KB];
+				prg_banks_[1] = (data & 0x3F) * 8_KB;
+				prgBankSwitched();
 				break;
 			}
 		}
@@ -83,12 +89,13 @@ bool Mapper004::cpuMapWrite(const u16 addr, const u8 data)
 	{
 		if (addr_is_even)
 		{
-			cart_.mirror_type = (data & 0x01 ? MirrorType::Horizontal : MirrorType::Vertical);
+			setMirroring(data & 0x01 ? MirrorType::Horizontal : MirrorType::Vertical);
 		}
 		else
 		{
 			ram_write_protect_ = getBitN(data, 6);
 			ram_enable_ = getBitN(data, 7);
+			remapCPUPages();
 		}
 	}
 	else if (addr <= 0xDFFF)
@@ -127,50 +134,64 @@ std::optional<u8> Mapper004::cpuMapRead(const u16 addr)
 
 	if (addr < 0x8000)
 	{
-		return prg_ram_[addr & 0x1FFF];
+		return prgRAM()[addr & 0x1FFF];
+	}
+	return *prgRomPtr(addr);
+}
+
+CPUPage Mapper004::cpuPage(const u16 addr)
+{
+	if (addr < 0x8000)
+	{
+		u8* const ram = &prgRAM()[addr & 0x1FFF];
+		return { ram, ram_write_protect_ ? nullptr : ram };
+	}
+	return Mapper::cpuPage(addr);
+}
+
+const u8* Mapper004::prgRomPtr(const u16 addr)
+{
+	if (addr < 0x8000)
+	{
+		return nullptr;
 	}
 
 	if (addr <= 0x9FFF)
 	{
 		if (!prg_bank_mode_)
 		{
-			return prg_banks_[0][addr & 0x1FFF];
+			return &cart_.PRGRom()[prg_banks_[0] + (addr & 0x1FFF)];
 		}
-		return fix_prg_second_last_[addr & 0x1FFF];
+		return &cart_.PRGRom()[fix_prg_second_last_ + (addr & 0x1FFF)];
 	}
 	if (addr <= 0xBFFF)
 	{
-		return prg_banks_[1][addr & 0x1FFF];
+		return &cart_.PRGRom()[prg_banks_[1] + (addr & 0x1FFF)];
 	}
 	if (addr <= 0xDFFF)
 	{
 		if (!prg_bank_mode_)
 		{
-			return fix_prg_second_last_[addr & 0x1FFF];
+			return &cart_.PRGRom()[fix_prg_second_last_ + (addr & 0x1FFF)];
 		}
-		return prg_banks_[0][addr & 0x1FFF];
+		return &cart_.PRGRom()[prg_banks_[0] + (addr & 0x1FFF)];
 	}
-	return fix_prg_last_[addr & 0x1FFF];
+	return &cart_.PRGRom()[fix_prg_last_ + (addr & 0x1FFF)];
 }
 
-std::optional<u8> Mapper004::ppuMapRead(const u16 addr)
+u8* Mapper004::chrPtr(const u16 addr)
 {
-	if (addr >= 0x2000)
-	{
-		return std::nullopt;
-	}
-
 	if (addr <= 0x07FF)
 	{
 		if (chr_bank_inversion_)
 		{
 			if (addr <= 0x03FF)
 			{
-				return chr_1kbanks_[0][addr & 0x03FF];
+				return &CHRMem()[chr_1kbanks_[0] + (addr & 0x03FF)];
 			}
-			return chr_1kbanks_[1][addr & 0x03FF];
+			return &CHRMem()[chr_1kbanks_[1] + (addr & 0x03FF)];
 		}
-		return chr_2kbanks_[0][addr & 0x07FF];
+		return &CHRMem()[chr_2kbanks_[0] + (addr & 0x07FF)];
 	}
 	if (addr <= 0x0FFF)
 	{
@@ -178,11 +199,11 @@ std::optional<u8> Mapper004::ppuMapRead(const u16 addr)
 		{
 			if (addr <= 0x0BFF)
 			{
-				return chr_1kbanks_[2][addr & 0x03FF];
+				return &CHRMem()[chr_1kbanks_[2] + (addr & 0x03FF)];
 			}
-			return chr_1kbanks_[3][addr & 0x03FF];
+			return &CHRMem()[chr_1kbanks_[3] + (addr & 0x03FF)];
 		}
-		return chr_2kbanks_[1][addr & 0x07FF];
+		return &CHRMem()[chr_2kbanks_[1] + (addr & 0x07FF)];
 	}
 	if (addr <= 0x17FF)
 	{
@@ -190,21 +211,21 @@ std::optional<u8> Mapper004::ppuMapRead(const u16 addr)
 		{
 			if (addr <= 0x13FF)
 			{
-				return chr_1kbanks_[0][addr & 0x03FF];
+				return &CHRMem()[chr_1kbanks_[0] + (addr & 0x03FF)];
 			}
-			return chr_1kbanks_[1][addr & 0x03FF];
+			return &CHRMem()[chr_1kbanks_[1] + (addr & 0x03FF)];
 		}
-		return chr_2kbanks_[0][addr & 0x07FF];
+		return &CHRMem()[chr_2kbanks_[0] + (addr & 0x07FF)];
 	}
 	if (!chr_bank_inversion_)
 	{
 		if (addr <= 0x1BFF)
 		{
-			return chr_1kbanks_[2][addr & 0x03FF];
+			return &CHRMem()[chr_1kbanks_[2] + (addr & 0x03FF)];
 		}
-		return chr_1kbanks_[3][addr & 0x03FF];
+		return &CHRMem()[chr_1kbanks_[3] + (addr & 0x03FF)];
 	}
-	return chr_2kbanks_[1][addr & 0x07FF];
+	return &CHRMem()[chr_2kbanks_[1] + (addr & 0x07FF)];
 }
 
 void Mapper004::updateIRQCounter()
@@ -223,3 +244,8 @@ void Mapper004::updateIRQCounter()
 		irq = true;
 	}
 }
+
+void Mapper004::serializeBanks(StateArchive& ar)
+{
+	ar(prg_banks_, chr_2kbanks_, chr_1kbanks_, bank_select_, prg_bank_mode_, chr_bank_inversion_, ram_write_protect_, ram_enable_, irq_counter_, irq_latch_, irq_enable_, reload_flag_, scanline_tracker_);
+}
@@ -11,18 +11,24 @@ public:
 
 	bool cpuMapWrite(u16 addr, u8 data) override;
 	std::optional<u8> cpuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 
-	std::optional<u8> ppuMapRead(u16 addr) override;
+	u8* chrPtr(u16 addr) override;
 
 	void updateIRQCounter() override;
 
+protected:
+	void serializeBanks(StateArchive& ar) override;
+	CPUPage cpuPage(u16 addr) override;
+
 private:
-	u8* prg_banks_[2]{};
-	u8* fix_prg_second_last_;
-	u8* fix_prg_last_;
+	// offsets into PRG ROM and CHR memory
+	usize prg_banks_[2]{};
+	usize fix_prg_second_last_ = 0;
+	usize fix_prg_last_ = 0;
 
-	u8* chr_2kbanks_[2]{};
-	u8* chr_1kbanks_[4]{};
+	usize chr_2kbanks_[2]{};
+	usize chr_1kbanks_[4]{};
 
 	u8 bank_select_ = 0;
 	bool prg_bank_mode_ = false;
@@ -37,6 +43,4 @@ private:
 	bool reload_flag_ = false;
 
 	unsigned scanline_tracker_ = 100000;
-
-	std::vector<u8> prg_ram_;
 };
@@ -1,10 +1,9 @@
 #include "Mapper066.hpp"
+#include "../StateArchive.hpp"
 
 Mapper066::Mapper066(Cartridge cart) :
 	Mapper{ std::move(cart) }
 {
-	chr_rom = cart_.CHRMem();
-	prg_rom = cart_.PRGRom();
 }
 
 bool Mapper066::cpuMapWrite(const u16 addr, const u8 data)
@@ -15,25 +14,37 @@ bool Mapper066::cpuMapWrite(const u16 addr, const u8 data)
 	}
 	const usize chr_bank = data & 0x03;
 	const usize prg_bank = data & 0x30;
-	chr_rom = &cart_.CHRMem()[chr_bank *  8_KB];
-	prg_rom = &cart_.PRGRom()[prg_bank * 32_KB];
+	chr_bank_ = chr_bank * 8_KB;
+	prg_bank_ = prg_bank * 32_KB;
+	prgBankSwitched();
+	chrBankSwitched();
 	return true;
 }
 
 std::optional<u8> Mapper066::cpuMapRead(const u16 addr)
 {
-	if (addr < 0x8000)
+	if (const u8* data = prgRomPtr(addr))
 	{
-		return std::nullopt;
+		return *data;
 	}
-	return prg_rom[addr & 0x7FFF];
+	return std::nullopt;
 }
 
-std::optional<u8> Mapper066::ppuMapRead(u16 addr)
+const u8* Mapper066::prgRomPtr(const u16 addr)
 {
-	if (addr > 0x1FFF)
+	if (addr < 0x8000)
 	{
-		return std::nullopt;
+		return nullptr;
 	}
-	return chr_rom[addr];
+	return &cart_.PRGRom()[prg_bank_ + (addr & 0x7FFF)];
+}
+
+u8* Mapper066::chrPtr(const u16 addr)
+{
+	return &CHRMem()[chr_bank_ + addr];
+}
+
+void Mapper066::serializeBanks(StateArchive& ar)
+{
+	ar(chr_bank_, prg_bank_);
 }
@@ -10,10 +10,14 @@ public:
 
 	bool cpuMapWrite(u16 addr, u8 data) override;
 	std::optional<u8> cpuMapRead(u16 addr) override;
+	const u8* prgRomPtr(u16 addr) override;
 
-	std::optional<u8> ppuMapRead(u16 addr) override;
+	u8* chrPtr(u16 addr) override;
+
+protected:
+	void serializeBanks(StateArchive& ar) override;
 
 private:
-	u8* chr_rom;
-	u8* prg_rom;
+	usize chr_bank_ = 0; // offsets into CHR and PRG ROM
+	usize prg_bank_ = 0;
 };
\ No newline at end of file
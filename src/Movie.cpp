@@ -0,0 +1,223 @@
+#include "Movie.hpp"
+
+
+template<typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static T readValue(std::ifstream& file)
+{
+	T value{};
+	file.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return value;
+}
+
+static u64 fnv1a(const void* const data, const usize size, u64 hash = 0xCBF29CE484222325)
+{
+	const u8* const bytes = static_cast<const u8*>(data);
+	for (usize i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001B3;
+	}
+	return hash;
+}
+
+Movie Movie::load(const std::filesystem::path& path)
+{
+	std::ifstream file;
+	file.exceptions(std::ios::failbit | std::ios::badbit);
+
+	file.open(path, std::ios::binary);
+
+	Movie movie;
+	try
+	{
+		if (readValue<u32>(file) != magic)
+		{
+			throw std::runtime_error{ "Not a movie file" };
+		}
+		if (readValue<u32>(file) != format_version)
+		{
+			throw std::runtime_error{ "Movie file is from another version" };
+		}
+		movie.rom_hash_ = readValue<u64>(file);
+		if (readValue<u32>(file) != check_interval)
+		{
+			throw std::runtime_error{ "Movie file uses another check interval" };
+		}
+		movie.buttons_.resize(readValue<u32>(file));
+		movie.events_.resize(readValue<u32>(file));
+		movie.checks_.resize(readValue<u32>(file));
+		if (movie.checks_.size() != movie.buttons_.size() / check_interval)
+		{
+			throw std::runtime_error{ "Movie file is corrupt" };
+		}
+
+		file.read(reinterpret_cast<char*>(movie.buttons_.data()), static_cast<std::streamsize>(movie.buttons_.size()));
+		u32 last_frame = 0;
+		for (EventAt& event : movie.events_)
+		{
+			event.frame = readValue<u32>(file);
+			event.event = readValue<Event>(file);
+			if (event.frame < last_frame || event.frame >= movie.buttons_.size() || event.event > Event::Reset)
+			{
+				throw std::runtime_error{ "Movie file is corrupt" };
+			}
+			last_frame = event.frame;
+		}
+		for (Check& check : movie.checks_)
+		{
+			check.frame_hash = readValue<u64>(file);
+			check.ram_hash = readValue<u64>(file);
+		}
+	}
+	catch (const std::ios::failure&)
+	{
+		throw std::runtime_error{ "Movie file is truncated" };
+	}
+	return movie;
+}
+
+void Movie::save(const std::filesystem::path& path) const
+{
+	std::ofstream file;
+	file.exceptions(std::ios::failbit | std::ios::badbit);
+
+	file.open(path, std::ios::binary);
+
+	writeValue(file, magic);
+	writeValue(file, format_version);
+	writeValue(file, rom_hash_);
+	writeValue(file, check_interval);
+	writeValue(file, static_cast<u32>(buttons_.size()));
+	writeValue(file, static_cast<u32>(events_.size()));
+	writeValue(file, static_cast<u32>(checks_.size()));
+	file.write(reinterpret_cast<const char*>(buttons_.data()), static_cast<std::streamsize>(buttons_.size()));
+	for (const EventAt& event : events_)
+	{
+		writeValue(file, event.frame);
+		writeValue(file, event.event);
+	}
+	for (const Check& check : checks_)
+	{
+		writeValue(file, check.frame_hash);
+		writeValue(file, check.ram_hash);
+	}
+}
+
+void Movie::startRecording(NESCore& core)
+{
+	rom_hash_ = core.romHash();
+	buttons_.clear();
+	events_.clear();
+	checks_.clear();
+	frame_ = 0;
+	next_event_ = 0;
+	desync_frame_.reset();
+
+	// the buttons held now are the first frame's, power on clears them
+	const u8 buttons = core.buttons();
+	core.powerOn();
+	core.setButtons(buttons);
+}
+
+void Movie::powerOn(NESCore& core)
+{
+	events_.push_back({ frame_, Event::PowerOn });
+	const u8 buttons = core.buttons();
+	core.powerOn();
+	core.setButtons(buttons);
+}
+
+void Movie::reset(NESCore& core)
+{
+	events_.push_back({ frame_, Event::Reset });
+	core.reset();
+}
+
+void Movie::recordFrame(NESCore& core)
+{
+	buttons_.push_back(core.buttons());
+	core.runFrame();
+	++frame_;
+	if (frame_ % check_interval == 0)
+	{
+		checks_.push_back(hashConsole(core));
+	}
+}
+
+void Movie::startPlayback(NESCore& core)
+{
+	if (core.romHash() != rom_hash_)
+	{
+		throw std::runtime_error{ "Movie was recorded with another ROM" };
+	}
+	frame_ = 0;
+	next_event_ = 0;
+	desync_frame_.reset();
+	core.powerOn();
+}
+
+bool Movie::playFrame(NESCore& core)
+{
+	if (frame_ >= buttons_.size())
+	{
+		return false;
+	}
+
+	for (; next_event_ < events_.size() && events_[next_event_].frame == frame_; ++next_event_)
+	{
+		if (events_[next_event_].event == Event::PowerOn)
+		{
+			core.powerOn();
+		}
+		else
+		{
+			core.reset();
+		}
+	}
+	core.setButtons(buttons_[frame_]);
+	core.runFrame();
+	++frame_;
+
+	if (frame_ % check_interval == 0 && !desync_frame_)
+	{
+		const Check& expected = checks_[frame_ / check_interval - 1];
+		const Check check = hashConsole(core);
+		if (check.frame_hash != expected.frame_hash || check.ram_hash != expected.ram_hash)
+		{
+			desync_frame_ = frame_ - 1;
+		}
+	}
+	return true;
+}
+
+bool Movie::nextFrameChecked() const
+{
+	return (frame_ + 1) % check_interval == 0;
+}
+
+std::optional<u32> Movie::desyncFrame() const
+{
+	return desync_frame_;
+}
+
+u32 Movie::frames() const
+{
+	return static_cast<u32>(buttons_.size());
+}
+
+u32 Movie::position() const
+{
+	return frame_;
+}
+
+Movie::Check Movie::hashConsole(NESCore& core)
+{
+	const std::vector<u16>& frame = core.frameBuffer();
+	const MachineMemory& memory = core.bus().memory();
+	return { fnv1a(frame.data(), frame.size() * sizeof(u16)), fnv1a(&memory, sizeof(memory)) };
+}
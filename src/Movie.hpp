@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pch.hpp"
+#include "NESCore.hpp"
+
+#include <optional>
+
+
+// An input movie: everything fed into the console since power on, so a run
+// can be played back exactly. It holds the ROM hash, the power on and reset
+// events and one byte of buttons per frame. The buttons are set before the
+// frame runs, so the game sees them when it strobes $4016.
+//
+// Every check_interval frames the recording also keeps a hash of the frame
+// and of all console RAM (MachineMemory). Playback compares them as it goes,
+// so a desync shows up within check_interval frames of where it happened.
+class Movie
+{
+public:
+	static constexpr u32 magic = 0x4D53454E; // "NESM"
+	static constexpr u32 format_version = 1;
+	static constexpr u32 check_interval = 60; // frames
+
+	enum class Event : u8
+	{
+		PowerOn,
+		Reset
+	};
+
+	// throws std::runtime_error if the file cannot be read or is not a movie
+	static Movie load(const std::filesystem::path& path);
+
+	// throws std::runtime_error if the file cannot be written
+	void save(const std::filesystem::path& path) const;
+
+	// Starts a new recording from power on. Until the next start, the
+	// console must only be changed through the calls below.
+	void startRecording(NESCore& core);
+	void powerOn(NESCore& core);
+	void reset(NESCore& core);
+	void recordFrame(NESCore& core); // with the buttons set on the core
+
+	// Powers the console on to play the movie from the start. Throws
+	// std::runtime_error if it was recorded with another ROM.
+	void startPlayback(NESCore& core);
+
+	// runs the next frame with its events and buttons, false at the end
+	bool playFrame(NESCore& core);
+
+	// whether the next frame is hashed; only then does it need video output
+	bool nextFrameChecked() const;
+
+	// the first frame whose hashes did not match the recording
+	std::optional<u32> desyncFrame() const;
+
+	u32 frames() const;   // recorded
+	u32 position() const; // frames run since the start
+
+private:
+	struct EventAt
+	{
+		u32 frame;
+		Event event;
+	};
+
+	struct Check
+	{
+		u64 frame_hash;
+		u64 ram_hash;
+	};
+
+	static Check hashConsole(NESCore& core);
+
+	u64 rom_hash_ = 0;
+	std::vector<u8> buttons_;     // per frame
+	std::vector<EventAt> events_; // before the frame, in order
+	std::vector<Check> checks_;   // after every check_interval frames
+
+	u32 frame_ = 0;
+	usize next_event_ = 0;
+	std::optional<u32> desync_frame_;
+};
@@ -0,0 +1,154 @@
+#include "NESCore.hpp"
+#include "Mapper/AllMapper.hpp"
+
+
+u8 NESCore::loadROM(const std::filesystem::path& path)
+{
+	Cartridge cart;
+	const u8 mapper_type = cart.loadiNESFile(path);
+	bus_.insertCartridge(createMapper(std::move(cart), mapper_type));
+	power_on_state_.resize(bus_.saveState(nullptr, 0));
+	bus_.saveState(power_on_state_.data(), power_on_state_.size());
+	return mapper_type;
+}
+
+void NESCore::reset()
+{
+	bus_.reset();
+}
+
+void NESCore::powerOn()
+{
+	bus_.loadState(power_on_state_.data(), power_on_state_.size());
+}
+
+u64 NESCore::romHash()
+{
+	return bus_.cartridge().romHash();
+}
+
+void NESCore::setButton(const Botton button, const bool pressed)
+{
+	bus_.joystick.setBotton(button, pressed);
+}
+
+u8 NESCore::buttons() const
+{
+	return bus_.joystick.buttons();
+}
+
+void NESCore::setButtons(const u8 buttons)
+{
+	bus_.joystick.setButtons(buttons);
+}
+
+void NESCore::runFrame()
+{
+	bus_.runFrame();
+}
+
+usize NESCore::saveState(u8* const buffer, const usize size)
+{
+	return bus_.saveState(buffer, size);
+}
+
+void NESCore::loadState(const u8* const data, const usize size)
+{
+	bus_.loadState(data, size);
+}
+
+void NESCore::setVideoOutput(const bool enable)
+{
+	bus_.ppu.video_output = enable;
+}
+
+void NESCore::holdAudio(const bool hold)
+{
+	bus_.apu.holdOutput(hold);
+}
+
+void NESCore::playHeldAudio()
+{
+	bus_.apu.playHeldFrame();
+}
+
+void NESCore::dropHeldAudio()
+{
+	bus_.apu.dropHeldFrames();
+}
+
+void NESCore::loadPalette(const std::filesystem::path& path)
+{
+	bus_.ppu.loadPalette(path);
+}
+
+const std::vector<u16>& NESCore::frameBuffer() const
+{
+	return bus_.ppu.getVideoOutput();
+}
+
+void NESCore::frameToRGBA(u8* const rgba) const
+{
+	bus_.ppu.convertVideoOutput(rgba);
+}
+
+void NESCore::setSampleRate(const double rate)
+{
+	bus_.apu.setSampleRate(rate);
+}
+
+void NESCore::setAudioRateAdjust(const double ratio)
+{
+	bus_.apu.setRateAdjust(ratio);
+}
+
+void NESCore::getSamples(std::vector<i16>& buf)
+{
+	bus_.apu.getSamples(buf);
+}
+
+usize NESCore::readSamples(i16* const out, const usize count)
+{
+	return bus_.apu.readSamples(out, count);
+}
+
+AudioBuffer::Stats NESCore::audioStats() const
+{
+	return bus_.apu.audioStats();
+}
+
+Bus& NESCore::bus()
+{
+	return bus_;
+}
+
+std::unique_ptr<Mapper> NESCore::createMapper(Cartridge cart, const u8 mapper_type)
+{
+	switch (mapper_type)
+	{
+	case 000:
+		return std::make_unique<Mapper000>(std::move(cart));
+
+	case 001:
+		return std::make_unique<Mapper001>(std::move(cart));
+
+	case 002:
+		return std::make_unique<Mapper002>(std::move(cart));
+
+	case 003:
+		return std::make_unique<Mapper003>(std::move(cart));
+
+	case 004:
+		return std::make_unique<Mapper004>(std::move(cart));
+
+	case 066:
+		return std::make_unique<Mapper066>(std::move(cart));
+
+	default:
+	{
+		char err_msg[50] = "";
+		std::snprintf(err_msg, 50, "Unsupport mapper %03d", (int)mapper_type);
+		throw std::runtime_error{ err_msg };
+	}
+	}
+}
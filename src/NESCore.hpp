@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pch.hpp"
+#include "Bus.hpp"
+
+
+// The console without any frontend: load a ROM, set the controller, run it a
+// frame at a time and read back the picture and the sound.
+class NESCore
+{
+public:
+	static constexpr usize screen_width = 256;
+	static constexpr usize screen_height = 240;
+
+	// returns the iNES mapper number, throws std::runtime_error if the ROM cannot be used
+	u8 loadROM(const std::filesystem::path& path);
+
+	void reset();
+
+	// back to the state right after loadROM, as if the console was switched
+	// off and on again
+	void powerOn();
+
+	// see Cartridge::romHash
+	u64 romHash();
+
+	// replaces the built-in colors with a .pal file (64 or 512 RGB triples),
+	// throws std::runtime_error if it cannot be used
+	void loadPalette(const std::filesystem::path& path);
+
+	void setButton(Botton button, bool pressed);
+
+	// all eight buttons at once, one bit each as in Botton
+	u8 buttons() const;
+	void setButtons(u8 buttons);
+
+	void runFrame();
+
+	// Save states, see Bus::saveState. saveState returns the size of the
+	// state, which was only written if it fit into size bytes.
+	usize saveState(u8* buffer, usize size);
+	void loadState(const u8* data, usize size);
+
+	// For frames run ahead of time, see RunAhead. Without video output the
+	// frame buffer is left as it is; held audio is kept back until it is
+	// played or dropped, see APU::holdOutput.
+	void setVideoOutput(bool enable);
+	void holdAudio(bool hold);
+	void playHeldAudio();
+	void dropHeldAudio();
+
+	// screen_width * screen_height pixels, row by row: the palette index in
+	// bits 0-5 and the PPUMASK emphasis bits in bits 6-8
+	const std::vector<u16>& frameBuffer() const;
+
+	// converts the frame buffer to 8 bit RGBA, 4 bytes per pixel
+	void frameToRGBA(u8* rgba) const;
+
+	// output rate of getSamples, 44100 Hz by default
+	void setSampleRate(double rate);
+
+	// Makes the next frames produce ratio times as many samples, so a host
+	// whose audio clock runs a little fast or slow can keep the queue steady.
+	void setAudioRateAdjust(double ratio);
+
+	// moves the samples produced since the last call into buf
+	void getSamples(std::vector<i16>& buf);
+
+	// moves up to count queued samples into out and returns how many; unlike
+	// the rest of the core this may be called from the audio thread
+	usize readSamples(i16* out, usize count);
+
+	AudioBuffer::Stats audioStats() const;
+
+	Bus& bus();
+
+private:
+	static std::unique_ptr<Mapper> createMapper(Cartridge cart, u8 mapper_type);
+
+	Bus bus_;
+	std::vector<u8> power_on_state_;
+};
@@ -1,21 +1,20 @@
 #include "PPU2C02.hpp"
 #include "Bus.hpp"
+#include "LineCompositor.hpp"
+#include "StateArchive.hpp"
 
+#include <cstring>
+#include <limits>
 
-PPU2C02::PPU2C02() :
-	mem_(mem_size, 0),
-	primary_oam_(primary_oam_size, 0),
-	pixels_(resolution),
-	second_oam_(second_oam_size),
-	sprite_buf_(8)
+
+PPU2C02::PPU2C02(Bus& bus) :
+	bus_{ bus },
+	pixels_(resolution, 0x0F),
+	palette_ram_{ bus.memory().palette },
+	vram_{ bus.memory().vram },
+	primary_oam_{ bus.memory().oam }
 {
-	std::size_t i = 0;
-	for (int row = 0; row < 240; ++row)
-		for (int col = 0; col < 256; ++col, ++i)
-		{
-			pixels_[i].setPosition({ static_cast<float>(col), static_cast<float>(row) });
-			pixels_[i].setColor(sf::Color::Black);
-		}
+	indexOAM();
 }
 
 void PPU2C02::reset()
@@ -29,420 +28,654 @@ void PPU2C02::reset()
 	scanline_ = cycle_ = 0;
 }
 
-void PPU2C02::cycle()
+void PPU2C02::insertCartridge()
 {
-	const auto fetchName = [this] {
-		const u16 next_tile_addr = 0x2000 | (vram_addr_.getValueAs<u16>() & 0x0FFF);
-		bg_latches_.tile_name = memRead(next_tile_addr);
-	};
-	const auto fetchAttribute = [this] {
-		const auto v = vram_addr_.getValueAs<u16>();
-		u16 next_attr_addr = 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07);
+	Mapper& cart = bus_.cartridge();
+	cart.mapPPUPages(ppu_pages_.data(), vram_.data());
+	tiles_.reset(cart.CHRMem(), cart.CHRMemSize());
+	mapCHRPages();
+}
 
-		const u8 data = memRead(next_attr_addr);
-		const bool is_top = (vram_addr_.bit.coarse_y & 0x03) < 2;
-		const bool is_left = (vram_addr_.bit.coarse_x & 0x03) < 2;
-		u8 offset = 0;
-		if (is_top)
+void PPU2C02::serialize(StateArchive& ar)
+{
+	ar(control_, mask_, status_, vram_addr_, tvram_addr_, write_latch_, fine_x);
+	ar(second_oam_, second_oam_count_, oam_addr_, sprite_buf_, sprite_count_, sprite_hit_potential_);
+	ar(data_buf_, bg_latches_, shift_reg_, scanline_, cycle_, total_cycle_, open_bus_, odd_frame_);
+	ar(nmi, frame_complete);
+	ar.bytes(pixels_.data(), pixels_.size() * sizeof(u16));
+	if (ar.loading())
+	{
+		indexOAM();
+		Mapper& cart = bus_.cartridge();
+		if (cart.useCHRRam())
 		{
-			if (is_left) // top left
-			{
-				offset = 0;
-			}
-			else // top right
-			{
-				offset = 2;
-			}
+			tiles_.reset(cart.CHRMem(), cart.CHRMemSize());
+		}
+		mapCHRPages();
+	}
+}
+
+void PPU2C02::run(u32 dots)
+{
+	while (dots > 0)
+	{
+		// the bus catches the PPU up before every register access and mapper
+		// write, so nothing can change the rendering state inside one run
+		if (cycle_ == 1 && scanline_ < 240 && dots >= 257)
+		{
+			renderScanline();
+			dots -= 257;
 		}
 		else
 		{
-			if (is_left) // bottom left
-			{
-				offset = 4;
-			}
-			else // bottom right
-			{
-				offset = 6;
-			}
+			cycle();
+			--dots;
 		}
-		const u8 pal = (data >> offset);
-		bg_latches_.attr_low = (getBitN(pal, 0) ? 0xFF : 0x00);
-		bg_latches_.attr_high = (getBitN(pal, 1) ? 0xFF : 0x00);
-	};
-	const auto fetchLowerPattern = [this] {
-		u16 next_pat_addr = control_.bit.bg_patterntb_addr;
-		next_pat_addr = (next_pat_addr << 8) | bg_latches_.tile_name;
-		next_pat_addr = (next_pat_addr << 1) | 0x00;
-		next_pat_addr = (next_pat_addr << 3) | vram_addr_.bit.fine_y;
-		bg_latches_.pat_low = memRead(next_pat_addr);
-	};
-	const auto fetchUpperPattern = [this] {
-		u16 next_pat_addr = control_.bit.bg_patterntb_addr;
-		next_pat_addr = (next_pat_addr << 8) | bg_latches_.tile_name;
-		next_pat_addr = (next_pat_addr << 1) | 0x01;
-		next_pat_addr = (next_pat_addr << 3) | vram_addr_.bit.fine_y;
-		bg_latches_.pat_high = memRead(next_pat_addr);
-	};
-	const auto loadRegisters = [this] {
-		shift_reg_.pat_high  = (shift_reg_.pat_high  & 0xFF00) | bg_latches_.pat_high;
-		shift_reg_.pat_low   = (shift_reg_.pat_low   & 0xFF00) | bg_latches_.pat_low;
-		shift_reg_.attr_high = (shift_reg_.attr_high & 0xFF00) | bg_latches_.attr_high;
-		shift_reg_.attr_low  = (shift_reg_.attr_low  & 0xFF00) | bg_latches_.attr_low;
-	};
-	const auto drawBGPixel = [this](u8& pal, u8& pat) {
-		if (cycle_ > 256 || scanline_ == 261 || cycle_ == 0) return;
-		const u8 pos        = 15 - (fine_x & 0x07);
-		const u8 pixel_high = getBitN(shift_reg_.pat_high, pos);
-		const u8 pixel_low  = getBitN(shift_reg_.pat_low, pos);
-		const u8 pal_high   = getBitN(shift_reg_.attr_high, pos);
-		const u8 pal_low    = getBitN(shift_reg_.attr_low, pos);
-		pat = (pixel_high << 1) | pixel_low;
-		pal = (pal_high << 1)   | pal_low;
-	};
-	const auto shiftRegisters = [this] {
-		shift_reg_.pat_high  <<= 1;
-		shift_reg_.pat_low   <<= 1;
-		shift_reg_.attr_high <<= 1;
-		shift_reg_.attr_low  <<= 1;
-	};
-	const auto incCoarseX = [this] {
-		if (vram_addr_.bit.coarse_x == 31)
+	}
+}
+
+void PPU2C02::cycle()
+{
+	if (cycle_ == 0 && scanline_ == 0)
+	{
+		cycle_ = 1;
+		if (!renderEnable() || !odd_frame_)
 		{
-			vram_addr_.bit.coarse_x = 0;
-			vram_addr_.bit.nametable_x = ~vram_addr_.bit.nametable_x;
+			return;
 		}
-		else
-			++vram_addr_.bit.coarse_x;
-	};
-	const auto incY = [this] {
-		if (cycle_ != 256) return;
-		if (vram_addr_.bit.fine_y < 7)
-			++vram_addr_.bit.fine_y;
-		else
+	}
+
+	if (240 <= scanline_ && scanline_ <= 260)
+	{
+		if (scanline_ == 241 && cycle_ == 1)
 		{
-			vram_addr_.bit.fine_y = 0;
-			u8 y = vram_addr_.bit.coarse_y;
-			if (y == 29)
+			status_.bit.vb_start = 1;
+			if (control_.bit.gen_nmi)
 			{
-				y = 0;
-				vram_addr_.bit.nametable_y = ~vram_addr_.bit.nametable_y;
+				nmi = true;
 			}
-			else if (y == 31)
-				y = 0;
-			else
-				++y;
-			vram_addr_.bit.coarse_y = y;
-		}
-	};
-	const auto transferTtoV = [&] {
-		if (cycle_ == 257)
-		{
-			loadRegisters();
-			vram_addr_.bit.nametable_x = tvram_addr_.bit.nametable_x;
-			vram_addr_.bit.coarse_x = tvram_addr_.bit.coarse_x;
 		}
-		if (scanline_ == 261 && (280 <= cycle_ && cycle_ <= 304))
+	}
+	else
+	{
+		if (scanline_ == 261 && cycle_ == 1)
 		{
-			vram_addr_.bit.fine_y = tvram_addr_.bit.fine_y;
-			vram_addr_.bit.nametable_y = tvram_addr_.bit.nametable_y;
-			vram_addr_.bit.coarse_y = tvram_addr_.bit.coarse_y;
+			status_.bit.vb_start = 0;
+			status_.bit.sp0_hit = 0;
+			status_.bit.sp_overflow = 0;
+			sprite_count_ = 0;
 		}
-	};
-	const auto fetch = [&] {
-		if (!((cycle_ >= 2 && cycle_ < 258) || (cycle_ >= 321 && cycle_ < 338))) return;
-		shiftRegisters();
-		switch ((cycle_ - 1) % 8)
-		{
-		case 0:
-			loadRegisters();
-			fetchName();
-			break;
-
-		case 2:
-			fetchAttribute();
-			break;
 
-		case 4:
-			fetchLowerPattern();
-			break;
-
-		case 6:
-			fetchUpperPattern();
-			break;
-
-		case 7:
-			incCoarseX();
-			break;
-		}
-	};
-	const auto createSprites = [this] {
-		if (cycle_ != 340 || scanline_ >= 240) return;
-		sprite_buf_.clear();
-		for (std::size_t i = 0; i < second_oam_.size(); i += 4)
-		{
-			Sprite sprite{};
-			const u8 y_coord = second_oam_[i];
-			u16 tile_index = second_oam_[i + 1];
-			const u8 attribute = second_oam_[i + 2];
-			const bool flip_hor = getBitN(attribute, 6);
-			const bool flip_vert = getBitN(attribute, 7);
-			
-			sprite.x = second_oam_[i + 3];
-			sprite.palette = attribute & 0x03;
-			sprite.priority = getBitN(attribute, 5);
-			
-			u8 tile_pos = (scanline_ - y_coord) & 0x0F;
-			if (flip_vert)
+		u8 bg_pat = 0, bg_pal = 0;
+		if (mask_.bit.render_bg)
+		{
+			fetch();
+			if (cycle_ == 256)
 			{
-				tile_pos ^= (control_.bit.sp_size ? 0x0F : 0x07);
+				incY();
 			}
-			if (control_.bit.sp_size) // 8x16
+			if (cycle_ == 257)
 			{
-				u16 tile_pat_addr = (tile_index & 0x01) * 0x1000;
-				tile_index &= 0x00FE;
-				if (tile_pos >= 8)
-				{
-					tile_pos -= 8;
-					++tile_index;
-				}
-				tile_pat_addr += (tile_index << 4) + tile_pos;
-				sprite.pat_low = memRead(tile_pat_addr);
-				sprite.pat_high = memRead(tile_pat_addr + 8);
+				loadRegisters();
+				transferX();
 			}
-			else // 8x8
+			if (scanline_ == 261 && (280 <= cycle_ && cycle_ <= 304))
 			{
-				const u16 tile_pat_addr = control_.bit.sp_patterntb_addr * 0x1000 + (tile_index << 4) + tile_pos;
-				sprite.pat_low = memRead(tile_pat_addr);
-				sprite.pat_high = memRead(tile_pat_addr + 8);
+				transferY();
 			}
-			if (flip_hor)
+			if (mask_.bit.render_bg_lm_8pixels || cycle_ > 8)
 			{
-				const auto reverseByte = [](u8 b) {
-					b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-					b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-					b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-					return b;
-				};
-				sprite.pat_low  = reverseByte(sprite.pat_low);
-				sprite.pat_high = reverseByte(sprite.pat_high);
+				drawBGPixel(bg_pal, bg_pat);
 			}
-			sprite_buf_.push_back(sprite);
 		}
-	};
-	const auto spriteEval = [this] {
-		if (cycle_ != 256 || scanline_ >= 240) return;
-		u8 oam_n = 0, oam_m = 0;
-		second_oam_.clear();
-		sprite_hit_potential_ = false;
-		do
-		{
-			u8 sprite_addr = oam_n * 4 + oam_m;
-			const u8 y_coord = primary_oam_[sprite_addr];
-			const int diff = static_cast<int>(scanline_) - static_cast<int>(y_coord);
-			const bool sprite_in_range = (diff >= 0 && diff < (control_.bit.sp_size ? 16 : 8));
-			const bool second_oam_full = (second_oam_.size() >= 32);
-			if (second_oam_full)
-			{
-				if (sprite_in_range)
-				{
-					status_.bit.sp_overflow = 1;
-				}
-				else
-				{
-					oam_m = (oam_m + 1) % 4; // hardware bug
-				}
-			}
-			else
-			{
-				if (sprite_in_range)
-				{
-					second_oam_.push_back(primary_oam_[sprite_addr++]);
-					second_oam_.push_back(primary_oam_[sprite_addr++]);
-					second_oam_.push_back(primary_oam_[sprite_addr++]);
-					second_oam_.push_back(primary_oam_[sprite_addr]);
-					if (oam_n == 0)
-					{
-						sprite_hit_potential_ = true;
-					}
-				}
-			}
-		} while (++oam_n < 64);
-	};
-	const auto drawSprite = [this](u8& pal, u8& pat, bool& priority, usize& sprite_idx) {
-		if (cycle_ > 255 || scanline_ >= 240 || scanline_ == 0 || cycle_ == 0) return;
-		priority = true;
-		pal = 0; 
-		pat = 0;
-		for (usize i = 0; i < sprite_buf_.size(); ++i)
-		{
-			if (sprite_buf_[i].x > 0)
-				continue;
-			const u8 pat_low  = getBitN(sprite_buf_[i].pat_low, 7);
-			const u8 pat_high = getBitN(sprite_buf_[i].pat_high, 7);
-			const u8 pattern = (pat_high << 1) | pat_low;
-			if (pattern > 0)
+		u8 sp_pat = 0, sp_pal = 0;
+		bool sp_priority = false;
+		usize sprite_index = 0;
+		if (mask_.bit.render_sp)
+		{
+			if (mask_.bit.render_sp_lm_8pixels || cycle_ > 8)
 			{
-				pat = pattern;
-				pal = sprite_buf_[i].palette;
-				priority = sprite_buf_[i].priority;
-				sprite_idx = i;
-				return;
+				drawSprite(sp_pal, sp_pat, sp_priority, sprite_index);
 			}
+			updateSpriteShifter();
 		}
-	};
-	const auto updateSpriteShifter = [this] {
-		if (cycle_ > 256 || scanline_ >= 240 || cycle_ == 0) return;
-		for (auto& sprite : sprite_buf_)
+		
+		muxColor(bg_pat, bg_pal, sp_pat, sp_pal, sp_priority, sprite_index);
+
+		if (mask_.bit.render_bg | mask_.bit.render_sp)
 		{
-			if (sprite.x == 0)
+			if (cycle_ == 256 && scanline_ < 240)
 			{
-				sprite.pat_low  <<= 1;
-				sprite.pat_high <<= 1;
+				spriteEval();
 			}
-			else 
+			if (cycle_ == 340 && scanline_ < 240)
+			{
+				createSprites();
+			}
+			if (cycle_ == 260 && scanline_ < 240)
 			{
-				--sprite.x;
+				bus_.cartridge().updateIRQCounter();
 			}
 		}
+	}
+
+	++cycle_;
+	if (cycle_ > 340)
+	{
+		cycle_ = 0;
+		++scanline_;
+		if (scanline_ > 261)
+		{
+			frame_complete = true;
+			odd_frame_ = !odd_frame_;
+			scanline_ = 0;
+		}
+	}
+}
+
+void PPU2C02::renderScanline()
+{
+	const bool render_bg = mask_.bit.render_bg;
+	const bool render_sp = mask_.bit.render_sp;
+	if (bus_.cartridge().chrBankGeneration() != chr_generation_)
+	{
+		mapCHRPages();
+	}
+
+	// Background of the whole line as pal << 2 | pat. The first two tiles
+	// come from the shift registers, the other 31 are fetched in the same
+	// order as on dots 1-256 and read from the tile cache. Pixel x is at
+	// fine_x + x.
+	alignas(32) std::array<u8, 33 * 8> bg{};
+	const auto unpackTile = [&bg](const usize tile, const u8 pat_high, const u8 pat_low, const u8 attr_high, const u8 attr_low) {
+		for (u8 i = 0; i < 8; ++i)
+		{
+			const u8 pos = 7 - i;
+			const u8 pat = (getBitN(pat_high, pos) << 1) | getBitN(pat_low, pos);
+			const u8 pal = (getBitN(attr_high, pos) << 1) | getBitN(attr_low, pos);
+			bg[tile * 8 + i] = (pal << 2) | pat;
+		}
 	};
-	const auto muxColor = [this](const u8 bg_pat, const u8 bg_pal, const u8 sp_pat, const u8 sp_pal, const bool priority, const usize sprite_idx) {
-		if (cycle_ > 256 || scanline_ >= 240 || cycle_ == 0) return;
-		bool is_sprite = false;
-		u8 pal = 0, pat = 0;
-		if (sp_pat == 0 || bg_pat == 0)
+	if (render_bg)
+	{
+		unpackTile(0, shift_reg_.pat_high >> 8, shift_reg_.pat_low >> 8, shift_reg_.attr_high >> 8, shift_reg_.attr_low >> 8);
+		unpackTile(1, shift_reg_.pat_high & 0xFF, shift_reg_.pat_low & 0xFF, shift_reg_.attr_high & 0xFF, shift_reg_.attr_low & 0xFF);
+
+		BackGroundLatches last_drawn{};
+		for (usize tile = 2; tile < 34; ++tile)
 		{
-			if (sp_pat == 0 && bg_pat == 0)
+			if (tile > 2) // the name of the first one was fetched on dot 337
 			{
-
+				fetchName();
 			}
-			else if (sp_pat == 0)
+			fetchAttribute();
+			if (tile < 32)
 			{
-				pat = bg_pat;
-				pal = bg_pal;
+				const u8 pal = ((bg_latches_.attr_high & 0x01) << 1) | (bg_latches_.attr_low & 0x01);
+				u64 row;
+				std::memcpy(&row, tileRow(bgPatternAddr(), false), sizeof(row));
+				row |= (pal << 2) * 0x0101010101010101ull;
+				std::memcpy(&bg[tile * 8], &row, sizeof(row));
 			}
-			else
+			else // the last two tiles are left in the shift registers
 			{
-				is_sprite = true;
-				pat = sp_pat;
-				pal = sp_pal;
+				fetchLowerPattern();
+				fetchUpperPattern();
+				if (tile == 32)
+				{
+					unpackTile(tile, bg_latches_.pat_high, bg_latches_.pat_low, bg_latches_.attr_high, bg_latches_.attr_low);
+					last_drawn = bg_latches_;
+				}
 			}
+			incCoarseX();
 		}
-		else
-		{ 
-			if (priority)
-			{
-				pat = bg_pat;
-				pal = bg_pal;
-			}
-			else
-			{
-				is_sprite = true;
-				pat = sp_pat;
-				pal = sp_pal;
-			}
+		incY();
+
+		// the shift registers as the dot by dot path leaves them on dot 257
+		shift_reg_.pat_high  = (u16(last_drawn.pat_high)  << 8) | bg_latches_.pat_high;
+		shift_reg_.pat_low   = (u16(last_drawn.pat_low)   << 8) | bg_latches_.pat_low;
+		shift_reg_.attr_high = (u16(last_drawn.attr_high) << 8) | bg_latches_.attr_high;
+		shift_reg_.attr_low  = (u16(last_drawn.attr_low)  << 8) | bg_latches_.attr_low;
+	}
+
+	// without video output the line is only needed for a sprite 0 hit
+	const bool compose = video_output || sprite_hit_potential_;
+	alignas(32) std::array<u8, 256> bg_pixels{}, bg_opaque{};
+	if (render_bg && compose)
+	{
+		const unsigned first_x = mask_.bit.render_bg_lm_8pixels ? 0 : 8;
+		LineCompositor::composeBackground(bg.data(), fine_x & 0x07, first_x, bg_pixels.data(), bg_opaque.data());
+	}
 
-			if (sprite_hit_potential_ && sprite_idx == 0)
+	// sprite pixels as pal << 2 | pat, the lowest sprite index wins
+	alignas(32) std::array<u8, 256> sp{}, sp_behind{}, sp_zero{};
+	if (render_sp)
+	{
+		for (usize i = sprite_count_; i-- > 0;)
+		{
+			auto& sprite = sprite_buf_[i];
+			for (unsigned col = sprite.col, x = sprite.x; compose && col < 8 && x < 256; ++col, ++x)
 			{
-				if (!mask_.bit.render_bg_lm_8pixels && !mask_.bit.render_sp_lm_8pixels)
-				{
-					if (cycle_ >= 9)
-					{
-						status_.bit.sp0_hit = 1;
-					}
-				}
-				else
+				const u8 pat = sprite.row[col];
+				if (pat > 0)
 				{
-					if (cycle_ >= 1)
-					{
-						status_.bit.sp0_hit = 1;
-					}
+					sp[x] = (sprite.palette << 2) | pat;
+					sp_behind[x] = sprite.priority ? 0xFF : 0x00;
+					sp_zero[x] = (i == 0) ? 0xFF : 0x00;
 				}
 			}
+			sprite.col = static_cast<u8>(std::min(sprite.col + 256u - sprite.x, 8u));
+			sprite.x = 0;
 		}
-		pixels_[scanline_ * 256 + cycle_ - 1].setColor(getColorFromPaletteRam(is_sprite, pal, pat));
-	};
 
+		// sprites are never drawn on line 0 and at x = 255
+		const unsigned first_x = mask_.bit.render_sp_lm_8pixels ? 0 : 8;
+		const unsigned last_x = (scanline_ == 0) ? 0 : 255;
+		std::fill(sp.begin(), sp.begin() + first_x, u8{ 0 });
+		std::fill(sp.begin() + std::max(first_x, last_x), sp.end(), u8{ 0 });
+	}
 
-	if (cycle_ == 0 && scanline_ == 0)
+	alignas(32) std::array<u8, 256> line;
+	if (compose
+		&& LineCompositor::mergeSprites(bg_pixels.data(), bg_opaque.data(), sp.data(), sp_behind.data(), sp_zero.data(), line.data())
+		&& sprite_hit_potential_)
 	{
-		cycle_ = 1;
-		if (!renderEnable() || !odd_frame_)
+		status_.bit.sp0_hit = 1;
+	}
+
+	if (video_output)
+	{
+		std::array<u16, 32> colors;
+		for (u16 i = 0; i < colors.size(); ++i)
 		{
-			return;
+			colors[i] = getPaletteIndex(i >> 4, (i >> 2) & 0x03, i & 0x03);
+		}
+		u16* const out = pixels_.data() + scanline_ * 256;
+		for (unsigned x = 0; x < 256; ++x)
+		{
+			out[x] = colors[line[x]];
 		}
 	}
 
-	if (240 <= scanline_ && scanline_ <= 260)
+	if (render_bg || render_sp)
 	{
-		if (scanline_ == 241 && cycle_ == 1)
+		spriteEval();
+	}
+
+	// dot 257
+	if (render_bg)
+	{
+		loadRegisters();
+		fetchName();
+		transferX();
+	}
+	cycle_ = 258;
+}
+
+void PPU2C02::fetchName()
+{
+	const u16 next_tile_addr = 0x2000 | (vram_addr_.getValueAs<u16>() & 0x0FFF);
+	bg_latches_.tile_name = memRead(next_tile_addr);
+}
+
+void PPU2C02::fetchAttribute()
+{
+	const auto v = vram_addr_.getValueAs<u16>();
+	u16 next_attr_addr = 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07);
+
+	const u8 data = memRead(next_attr_addr);
+	const bool is_top = (vram_addr_.bit.coarse_y & 0x03) < 2;
+	const bool is_left = (vram_addr_.bit.coarse_x & 0x03) < 2;
+	u8 offset = 0;
+	if (is_top)
+	{
+		if (is_left) // top left
 		{
-			status_.bit.vb_start = 1;
-			if (control_.bit.gen_nmi)
-			{
-				nmi = true;
-			}
+			offset = 0;
+		}
+		else // top right
+		{
+			offset = 2;
 		}
 	}
 	else
 	{
-		if (scanline_ == 261 && cycle_ == 1)
+		if (is_left) // bottom left
 		{
-			status_.bit.vb_start = 0;
-			status_.bit.sp0_hit = 0;
-			status_.bit.sp_overflow = 0;
-			sprite_buf_.clear();
+			offset = 4;
 		}
+		else // bottom right
+		{
+			offset = 6;
+		}
+	}
+	const u8 pal = (data >> offset);
+	bg_latches_.attr_low = (getBitN(pal, 0) ? 0xFF : 0x00);
+	bg_latches_.attr_high = (getBitN(pal, 1) ? 0xFF : 0x00);
+}
 
-		u8 bg_pat = 0, bg_pal = 0;
-		if (mask_.bit.render_bg)
+u16 PPU2C02::bgPatternAddr() const
+{
+	u16 next_pat_addr = control_.bit.bg_patterntb_addr;
+	next_pat_addr = (next_pat_addr << 8) | bg_latches_.tile_name;
+	next_pat_addr = (next_pat_addr << 4) | vram_addr_.bit.fine_y;
+	return next_pat_addr;
+}
+
+void PPU2C02::fetchLowerPattern()
+{
+	bg_latches_.pat_low = memRead(bgPatternAddr());
+}
+
+void PPU2C02::fetchUpperPattern()
+{
+	bg_latches_.pat_high = memRead(bgPatternAddr() | 0x08);
+}
+
+void PPU2C02::loadRegisters()
+{
+	shift_reg_.pat_high  = (shift_reg_.pat_high  & 0xFF00) | bg_latches_.pat_high;
+	shift_reg_.pat_low   = (shift_reg_.pat_low   & 0xFF00) | bg_latches_.pat_low;
+	shift_reg_.attr_high = (shift_reg_.attr_high & 0xFF00) | bg_latches_.attr_high;
+	shift_reg_.attr_low  = (shift_reg_.attr_low  & 0xFF00) | bg_latches_.attr_low;
+}
+
+void PPU2C02::drawBGPixel(u8& pal, u8& pat) const
+{
+	if (cycle_ > 256 || scanline_ == 261 || cycle_ == 0) return;
+	const u8 pos        = 15 - (fine_x & 0x07);
+	const u8 pixel_high = getBitN(shift_reg_.pat_high, pos);
+	const u8 pixel_low  = getBitN(shift_reg_.pat_low, pos);
+	const u8 pal_high   = getBitN(shift_reg_.attr_high, pos);
+	const u8 pal_low    = getBitN(shift_reg_.attr_low, pos);
+	pat = (pixel_high << 1) | pixel_low;
+	pal = (pal_high << 1)   | pal_low;
+}
+
+void PPU2C02::shiftRegisters()
+{
+	shift_reg_.pat_high  <<= 1;
+	shift_reg_.pat_low   <<= 1;
+	shift_reg_.attr_high <<= 1;
+	shift_reg_.attr_low  <<= 1;
+}
+
+void PPU2C02::incCoarseX()
+{
+	if (vram_addr_.bit.coarse_x == 31)
+	{
+		vram_addr_.bit.coarse_x = 0;
+		vram_addr_.bit.nametable_x = ~vram_addr_.bit.nametable_x;
+	}
+	else
+		++vram_addr_.bit.coarse_x;
+}
+
+void PPU2C02::incY()
+{
+	if (vram_addr_.bit.fine_y < 7)
+		++vram_addr_.bit.fine_y;
+	else
+	{
+		vram_addr_.bit.fine_y = 0;
+		u8 y = vram_addr_.bit.coarse_y;
+		if (y == 29)
 		{
-			fetch();
-			incY();
-			transferTtoV();
-			if (mask_.bit.render_bg_lm_8pixels || cycle_ > 8)
+			y = 0;
+			vram_addr_.bit.nametable_y = ~vram_addr_.bit.nametable_y;
+		}
+		else if (y == 31)
+			y = 0;
+		else
+			++y;
+		vram_addr_.bit.coarse_y = y;
+	}
+}
+
+void PPU2C02::transferX()
+{
+	vram_addr_.bit.nametable_x = tvram_addr_.bit.nametable_x;
+	vram_addr_.bit.coarse_x = tvram_addr_.bit.coarse_x;
+}
+
+void PPU2C02::transferY()
+{
+	vram_addr_.bit.fine_y = tvram_addr_.bit.fine_y;
+	vram_addr_.bit.nametable_y = tvram_addr_.bit.nametable_y;
+	vram_addr_.bit.coarse_y = tvram_addr_.bit.coarse_y;
+}
+
+void PPU2C02::fetch()
+{
+	if (!((cycle_ >= 2 && cycle_ < 258) || (cycle_ >= 321 && cycle_ < 338))) return;
+	shiftRegisters();
+	switch ((cycle_ - 1) % 8)
+	{
+	case 0:
+		loadRegisters();
+		fetchName();
+		break;
+
+	case 2:
+		fetchAttribute();
+		break;
+
+	case 4:
+		fetchLowerPattern();
+		break;
+
+	case 6:
+		fetchUpperPattern();
+		break;
+
+	case 7:
+		incCoarseX();
+		break;
+	}
+}
+
+void PPU2C02::createSprites()
+{
+	if (bus_.cartridge().chrBankGeneration() != chr_generation_)
+	{
+		mapCHRPages();
+	}
+	sprite_count_ = 0;
+	for (std::size_t i = 0; i < second_oam_count_ * 4u; i += 4)
+	{
+		Sprite sprite{};
+		const u8 y_coord = second_oam_[i];
+		u16 tile_index = second_oam_[i + 1];
+		const u8 attribute = second_oam_[i + 2];
+		const bool flip_hor = getBitN(attribute, 6);
+		const bool flip_vert = getBitN(attribute, 7);
+		
+		sprite.x = second_oam_[i + 3];
+		sprite.palette = attribute & 0x03;
+		sprite.priority = getBitN(attribute, 5);
+		
+		u8 tile_pos = (scanline_ - y_coord) & 0x0F;
+		if (flip_vert)
+		{
+			tile_pos ^= (control_.bit.sp_size ? 0x0F : 0x07);
+		}
+		u16 tile_pat_addr = 0;
+		if (control_.bit.sp_size) // 8x16
+		{
+			tile_pat_addr = (tile_index & 0x01) * 0x1000;
+			tile_index &= 0x00FE;
+			if (tile_pos >= 8)
 			{
-				drawBGPixel(bg_pal, bg_pat);
+				tile_pos -= 8;
+				++tile_index;
 			}
+			tile_pat_addr += (tile_index << 4) + tile_pos;
 		}
-		u8 sp_pat = 0, sp_pal = 0;
-		bool sp_priority = false;
-		usize sprite_index = 0;
-		if (mask_.bit.render_sp)
+		else // 8x8
 		{
-			if (mask_.bit.render_sp_lm_8pixels || cycle_ > 8)
+			tile_pat_addr = control_.bit.sp_patterntb_addr * 0x1000 + (tile_index << 4) + tile_pos;
+		}
+		const u8* const row = tileRow(tile_pat_addr, flip_hor);
+		std::copy(row, row + 8, sprite.row.begin());
+		sprite_buf_[sprite_count_++] = sprite;
+	}
+}
+
+void PPU2C02::spriteEval()
+{
+	const u64 in_range = oam_rows_[control_.bit.sp_size][scanline_];
+	if (countSetBits(in_range) >= 8)
+	{
+		// the 8th sprite starts the overflow search and its hardware bug
+		spriteEvalFull();
+		return;
+	}
+
+	second_oam_count_ = 0;
+	sprite_hit_potential_ = (in_range & 0x01) != 0;
+	for (u64 rest = in_range; rest != 0; rest &= rest - 1)
+	{
+		const u8* const sprite = &primary_oam_[lowestSetBit(rest) * 4];
+		std::copy(sprite, sprite + 4, &second_oam_[second_oam_count_ * 4]);
+		++second_oam_count_;
+	}
+}
+
+void PPU2C02::spriteEvalFull()
+{
+	u8 oam_n = 0, oam_m = 0;
+	second_oam_count_ = 0;
+	sprite_hit_potential_ = false;
+	do
+	{
+		u8 sprite_addr = oam_n * 4 + oam_m;
+		const u8 y_coord = primary_oam_[sprite_addr];
+		const int diff = static_cast<int>(scanline_) - static_cast<int>(y_coord);
+		const bool sprite_in_range = (diff >= 0 && diff < (control_.bit.sp_size ? 16 : 8));
+		const bool second_oam_full = (second_oam_count_ >= 8);
+		if (second_oam_full)
+		{
+			if (sprite_in_range)
 			{
-				drawSprite(sp_pal, sp_pat, sp_priority, sprite_index);
+				status_.bit.sp_overflow = 1;
+			}
+			else
+			{
+				oam_m = (oam_m + 1) % 4; // hardware bug
 			}
-			updateSpriteShifter();
 		}
-		
-		muxColor(bg_pat, bg_pal, sp_pat, sp_pal, sp_priority, sprite_index);
-
-		if (mask_.bit.render_bg | mask_.bit.render_sp)
+		else
 		{
-			spriteEval();
-			createSprites();
-			if (cycle_ == 260 && scanline_ < 240)
+			if (sprite_in_range)
 			{
-				Bus::instance().cartridge().updateIRQCounter();
+				std::copy_n(&primary_oam_[sprite_addr], 4, &second_oam_[second_oam_count_ * 4]);
+				++second_oam_count_;
+				if (oam_n == 0)
+				{
+					sprite_hit_potential_ = true;
+				}
 			}
 		}
+	} while (++oam_n < 64);
+}
+
+void PPU2C02::drawSprite(u8& pal, u8& pat, bool& priority, usize& sprite_idx) const
+{
+	if (cycle_ > 255 || scanline_ >= 240 || scanline_ == 0 || cycle_ == 0) return;
+	priority = true;
+	pal = 0; 
+	pat = 0;
+	for (usize i = 0; i < sprite_count_; ++i)
+	{
+		if (sprite_buf_[i].x > 0 || sprite_buf_[i].col >= 8)
+			continue;
+		const u8 pattern = sprite_buf_[i].row[sprite_buf_[i].col];
+		if (pattern > 0)
+		{
+			pat = pattern;
+			pal = sprite_buf_[i].palette;
+			priority = sprite_buf_[i].priority;
+			sprite_idx = i;
+			return;
+		}
 	}
+}
 
-	++cycle_;
-	if (cycle_ > 340)
+void PPU2C02::updateSpriteShifter()
+{
+	if (cycle_ > 256 || scanline_ >= 240 || cycle_ == 0) return;
+	for (usize i = 0; i < sprite_count_; ++i)
 	{
-		cycle_ = 0;
-		++scanline_;
-		if (scanline_ > 261)
+		auto& sprite = sprite_buf_[i];
+		if (sprite.x == 0)
 		{
-			frame_complete = true;
-			odd_frame_ = !odd_frame_;
-			scanline_ = 0;
+			sprite.col = std::min(sprite.col + 1, 8);
+		}
+		else 
+		{
+			--sprite.x;
 		}
 	}
 }
 
+void PPU2C02::muxColor(const u8 bg_pat, const u8 bg_pal, const u8 sp_pat, const u8 sp_pal, const bool priority, const usize sprite_idx)
+{
+	if (cycle_ > 256 || scanline_ >= 240 || cycle_ == 0) return;
+	bool is_sprite = false;
+	u8 pal = 0, pat = 0;
+	if (sp_pat == 0 || bg_pat == 0)
+	{
+		if (sp_pat == 0 && bg_pat == 0)
+		{
+
+		}
+		else if (sp_pat == 0)
+		{
+			pat = bg_pat;
+			pal = bg_pal;
+		}
+		else
+		{
+			is_sprite = true;
+			pat = sp_pat;
+			pal = sp_pal;
+		}
+	}
+	else
+	{ 
+		if (priority)
+		{
+			pat = bg_pat;
+			pal = bg_pal;
+		}
+		else
+		{
+			is_sprite = true;
+			pat = sp_pat;
+			pal = sp_pal;
+		}
+
+		if (sprite_hit_potential_ && sprite_idx == 0)
+		{
+			if (!mask_.bit.render_bg_lm_8pixels && !mask_.bit.render_sp_lm_8pixels)
+			{
+				if (cycle_ >= 9)
+				{
+					status_.bit.sp0_hit = 1;
+				}
+			}
+			else
+			{
+				if (cycle_ >= 1)
+				{
+					status_.bit.sp0_hit = 1;
+				}
+			}
+		}
+	}
+	pixels_[scanline_ * 256 + cycle_ - 1] = getPaletteIndex(is_sprite, pal, pat);
+}
+
 u8 PPU2C02::regRead(const u16 addr)
 {
 	assert(addr <= 7);
@@ -473,7 +706,7 @@ u8 PPU2C02::regRead(const u16 addr)
 		}
 		vram += (control_.bit.vram_addr_inc ? 32 : 1);
 		if (a12_toggle(vram_addr_.getValueAs<u16>(), vram)) {
-			Bus::instance().cartridge().updateIRQCounter();
+			bus_.cartridge().updateIRQCounter();
 		}
 		vram_addr_.setValue(vram);
 		break;
@@ -508,7 +741,7 @@ void PPU2C02::regWrite(const u16 addr, const u8 data)
 		break;
 
 	case 0x04:
-		primary_oam_[oam_addr_] = data;
+		writeOAM(oam_addr_, data);
 		++oam_addr_;
 		break;
 
@@ -540,7 +773,7 @@ void PPU2C02::regWrite(const u16 addr, const u8 data)
 			tvram = (tvram & 0xFF00) | data;
 			tvram_addr_.setValue(tvram);
 			if(a12_toggle(vram_addr_.getValueAs<u16>(), tvram_addr_.getValueAs<u16>())) {
-				Bus::instance().cartridge().updateIRQCounter();
+				bus_.cartridge().updateIRQCounter();
 			}
 			vram_addr_ = tvram_addr_;
 		} 
@@ -554,7 +787,7 @@ void PPU2C02::regWrite(const u16 addr, const u8 data)
 		memWrite(vram, data);
 		vram += (control_.bit.vram_addr_inc ? 32 : 1);
 		if(a12_toggle(vram_addr_.getValueAs<u16>(), vram)) {
-			Bus::instance().cartridge().updateIRQCounter();
+			bus_.cartridge().updateIRQCounter();
 		}
 		vram_addr_.setValue(vram);
 		break;
@@ -569,81 +802,166 @@ bool PPU2C02::a12_toggle(u16 old_addr, u16 addr) {
 u8 PPU2C02::memRead(u16 addr)
 {
 	addr &= 0x3FFF;
-	if (const auto data = Bus::instance().cartridge().ppuMapRead(addr); data.has_value())
+	if (addr >= 0x3F00)
 	{
-		return *data;
+		return palette_ram_[Palette::ramIndex(addr)];
 	}
-	return *mirroring(addr);
+	return ppu_pages_[addr / PPUPage::size].read[addr % PPUPage::size];
 }
 
 void PPU2C02::memWrite(u16 addr, const u8 data)
 {
 	addr &= 0x3FFF;
-	if (Bus::instance().cartridge().ppuMapWrite(addr, data))
+	if (addr >= 0x3F00)
+	{
+		palette_ram_[Palette::ramIndex(addr)] = data;
+		return;
+	}
+	u8* const page = ppu_pages_[addr / PPUPage::size].write;
+	if (page == nullptr) // CHR ROM
 	{
 		return;
 	}
-	*mirroring(addr) = data;
+	page[addr % PPUPage::size] = data;
+	if (addr < 0x2000) // CHR RAM
+	{
+		Mapper& cart = bus_.cartridge();
+		tiles_.invalidate(static_cast<usize>(&page[addr % PPUPage::size] - cart.CHRMem()) % cart.CHRMemSize());
+	}
 }
 
-const std::vector<sf::Vertex>& PPU2C02::getVideoOutput()
+const std::vector<u16>& PPU2C02::getVideoOutput() const
 {
-	return pixels_.getVertexArray();
+	return pixels_;
 }
 
-u8* const PPU2C02::OAM()
+void PPU2C02::convertVideoOutput(u8* const rgba) const
 {
-	return primary_oam_.data();
+	palette_.toRGBA(pixels_.data(), pixels_.size(), rgba);
 }
 
-u8 PPU2C02::getOAMAddr() const
+void PPU2C02::loadPalette(const std::filesystem::path& path)
 {
-	return oam_addr_;
+	palette_.loadPalFile(path);
+}
+
+void PPU2C02::writeOAM(const u8 addr, const u8 data)
+{
+	if ((addr & 0x03) == 0)
+	{
+		indexOAMY(addr / 4, primary_oam_[addr], data);
+	}
+	primary_oam_[addr] = data;
 }
 
-u8* PPU2C02::mirroring(u16 addr)
+void PPU2C02::writeOAMPage(const u8 addr, const u8* const data)
 {
-	if (0x2000 <= addr && addr <= 0x3EFF)
+	std::array<u8, primary_oam_size / 4> old_y;
+	for (usize n = 0; n < old_y.size(); ++n)
 	{
-		addr &= 0x2FFF;
-		switch (Bus::instance().cartridge().getMirrorType())
+		old_y[n] = primary_oam_[n * 4];
+	}
+
+	const usize first = primary_oam_size - addr;
+	std::memcpy(&primary_oam_[addr], data, first);
+	std::memcpy(primary_oam_.data(), data + first, addr);
+
+	for (usize n = 0; n < old_y.size(); ++n)
+	{
+		if (old_y[n] != primary_oam_[n * 4])
 		{
-		case MirrorType::Vertical:
-			if (0x2800 <= addr && addr <= 0x2FFF)
-			{
-				addr -= 0x0800;
-			}
-			break;
+			indexOAMY(static_cast<u8>(n), old_y[n], primary_oam_[n * 4]);
+		}
+	}
+}
 
-		case MirrorType::Horizontal:
-			if (0x2400 <= addr && addr <= 0x27FF)
-			{
-				addr -= 0x0400;
-			}
-			else if (0x2800 <= addr && addr <= 0x2BFF)
-			{
-				addr -= 0x0400;
-			}
-			else if (0x2C00 <= addr && addr <= 0x2FFF)
-			{
-				addr -= 0x0800;
-			}
-			break;
-			
-		case MirrorType::OneScreenLow:
-			addr &= 0x23FF;
-			break;
-			
-		case MirrorType::OneScreenHigh:
-			addr = (addr & 0x03FF) | 0x2C00;
-			break;
+void PPU2C02::indexOAMY(const u8 sprite, const u8 old_y, const u8 new_y)
+{
+	const u64 bit = u64{ 1 } << sprite;
+	for (usize size = 0; size < oam_rows_.size(); ++size)
+	{
+		auto& rows = oam_rows_[size];
+		const unsigned height = size ? 16 : 8;
+		for (unsigned line = old_y; line < old_y + height && line < rows.size(); ++line)
+		{
+			rows[line] &= ~bit;
+		}
+		for (unsigned line = new_y; line < new_y + height && line < rows.size(); ++line)
+		{
+			rows[line] |= bit;
 		}
 	}
-	else if (0x3F00 <= addr && addr <= 0x3FFF)
+}
+
+void PPU2C02::indexOAM()
+{
+	oam_rows_ = {};
+	for (u8 n = 0; n < 64; ++n)
 	{
-		return &palette_[addr];
+		indexOAMY(n, 0xFF, primary_oam_[n * 4]);
 	}
-	return &mem_[addr];
+}
+
+u8 PPU2C02::getOAMAddr() const
+{
+	return oam_addr_;
+}
+
+u32 PPU2C02::dotsUntilEvent() const
+{
+	constexpr int dots_per_line = 341;
+	constexpr int dots_per_frame = 262 * dots_per_line;
+	const int now = static_cast<int>(scanline_) * dots_per_line + cycle_;
+	const auto until = [now](const int scanline, const int dot)
+	{
+		const int dots = scanline * dots_per_line + dot - now;
+		return dots < 0 ? dots + dots_per_frame : dots;
+	};
+
+	int dots = std::min(until(241, 1), until(261, 340));
+	if (renderEnable())
+	{
+		int scanline = (cycle_ <= 260) ? static_cast<int>(scanline_) : static_cast<int>(scanline_) + 1;
+		if (scanline >= 240)
+			scanline = 0;
+		dots = std::min(dots, until(scanline, 260));
+	}
+	// the (not counted) odd frame dot skip can only bring the event closer
+	return static_cast<u32>(dots);
+}
+
+u32 PPU2C02::dotsUntilOAMRead() const
+{
+	if (!renderEnable())
+	{
+		return std::numeric_limits<u32>::max();
+	}
+
+	constexpr int dots_per_line = 341;
+	constexpr int dots_per_frame = 262 * dots_per_line;
+	int scanline = (cycle_ <= 256) ? static_cast<int>(scanline_) : static_cast<int>(scanline_) + 1;
+	if (scanline >= 240)
+		scanline = 0;
+	const int dots = scanline * dots_per_line + 256 - (static_cast<int>(scanline_) * dots_per_line + cycle_);
+	// minus the odd frame dot skip
+	return static_cast<u32>(std::max((dots < 0 ? dots + dots_per_frame : dots) - 1, 0));
+}
+
+const u8* PPU2C02::tileRow(const u16 addr, const bool flip)
+{
+	return tiles_.row(chr_pages_[addr >> 10] + (addr & 0x03FF), flip);
+}
+
+void PPU2C02::mapCHRPages()
+{
+	Mapper& cart = bus_.cartridge();
+	for (usize i = 0; i < chr_pages_.size(); ++i)
+	{
+		// banks past the end of CHR memory wrap around
+		const usize offset = static_cast<usize>(ppu_pages_[i].read - cart.CHRMem());
+		chr_pages_[i] = offset % cart.CHRMemSize();
+	}
+	chr_generation_ = cart.chrBankGeneration();
 }
 
 bool PPU2C02::renderEnable() const
@@ -651,30 +969,25 @@ bool PPU2C02::renderEnable() const
 	return (mask_.bit.render_bg | mask_.bit.render_sp);
 }
 
-sf::Color PPU2C02::getColorFromPaletteRam(const bool sprite, const u16 palette, const u16 pixel)
+u16 PPU2C02::getPaletteIndex(const bool sprite, const u16 palette, const u16 pixel)
 {
 	const u16 sp = sprite;
 	const u16 addr = ((sp << 4) | (palette << 2) | pixel);
-	return palette_.getColor(palette_[addr] & 0x3F);
+	const u8 mask = mask_.getValueAs<u8>();
+	const u16 emphasis = (mask & 0xE0) << 1;
+	// greyscale keeps only the luminance column of the color
+	const u8 color_mask = mask_.bit.grey_sacle ? 0x30 : 0x3F;
+	return (palette_ram_[Palette::ramIndex(addr)] & color_mask) | emphasis;
+}
+
+Color PPU2C02::getColorFromPaletteRam(const bool sprite, const u16 palette, const u16 pixel)
+{
+	return palette_.getColor(getPaletteIndex(sprite, palette, pixel) & 0x3F);
 }
 #ifdef EMU_DEBUG
-const std::vector<sf::Vertex>& PPU2C02::dbgGetPatterntb(const int index, const u8 palette)
+std::vector<Color> PPU2C02::dbgGetPatterntb(const int index, const u8 palette)
 {
-	static PixelArray patterntb[2]{ (128 * 128), (128 * 128) };
-	static bool is_init = false;
-
-	if (!is_init)
-	{
-		std::size_t i = 0;
-		for (int row = 0; row < 128; ++row)
-			for (int col = 0; col < 128; ++col, ++i)
-			{
-				patterntb[0][i].setPosition({ float(256 + 11 + col), float(11 + row) });
-				patterntb[1][i].setPosition({ float(256 + 11 + col), float(128 + 22 + row) });
-			}
-
-		is_init = true;
-	}
+	std::vector<Color> patterntb(128 * 128);
 
 	int row = 0, col = 0;
 	for (u16 addr = (index ? 0x1000 : 0x0000); addr < (index ? 0x2000 : 0x1000); addr += 16)
@@ -697,7 +1010,7 @@ const std::vector<sf::Vertex>& PPU2C02::dbgGetPatterntb(const int index, const u
 				first[i] >>= 1;
 				second[i] >>= 1;
 
-				patterntb[index][(row + i) * 128 + col + (7 - j)].setColor(getColorFromPaletteRam(false, palette, pixel));
+				patterntb[(row + i) * 128 + col + (7 - j)] = getColorFromPaletteRam(false, palette, pixel);
 			}
 		}
 
@@ -709,8 +1022,7 @@ const std::vector<sf::Vertex>& PPU2C02::dbgGetPatterntb(const int index, const u
 		}
 	}
 
-
-	return patterntb[index].getVertexArray();
+	return patterntb;
 }
 
 void PPU2C02::dbgDrawNametb(const u8 which)
@@ -740,7 +1052,6 @@ void PPU2C02::dbgDrawNametb(const u8 which)
 			{
 				for (int j = 0; j < 8; ++j)
 				{
-					Pixel pixel = pixels_[tl_pixel_idx + i * 256 + (7 - j)];
 					const u8 lowerbit = lower[i] & 0x01;
 					const u8 upperbit = upper[i] & 0x01;
 					const u8 index = (upperbit << 1) | lowerbit;
@@ -748,53 +1059,20 @@ void PPU2C02::dbgDrawNametb(const u8 which)
 					upper[i] >>= 1;
 					lower[i] >>= 1;
 
-					pixel.setColor(getColorFromPaletteRam(false, pal_sel, index));
+					pixels_[tl_pixel_idx + i * 256 + (7 - j)] = getPaletteIndex(false, pal_sel, index);
 				}
 			}
 		}
 	}
 }
 
-const std::vector<sf::Vertex>& PPU2C02::dbgGetFramePalette(const u8 index)
+std::array<Color, 4> PPU2C02::dbgGetFramePalette(const u8 index)
 {
-	static std::vector<sf::Vertex> frame_palette[8];
-	static bool init = false;
-	static float size = 7.5f;
-
-	if (!init)
-	{
-		sf::Vector2f pos{ 50.0f, 250.0f };
-		for (std::size_t i = 0; i < 8; ++i)
-		{
-			frame_palette[i].resize(16);
-			for (std::size_t j = 0; j < 4; ++j)
-			{
-				frame_palette[i][j * 4 + 0].position = pos;
-				frame_palette[i][j * 4 + 1].position = { pos.x + size, pos.y };
-				frame_palette[i][j * 4 + 2].position = { pos.x + size, pos.y + size };
-				frame_palette[i][j * 4 + 3].position = { pos.x, pos.y + size };
-				pos.x += size;
-			}
-
-			pos.x += size;
-			if (i == 3)
-			{
-				pos.y += size * 2;
-				pos.x = 50.0f;
-			}
-		}
-		init = true;
-	}
-
+	std::array<Color, 4> colors;
 	for (std::size_t j = 0; j < 4; ++j)
 	{
-		sf::Color color = getColorFromPaletteRam(false, index, j);
-		frame_palette[index][j * 4].color = color;
-		frame_palette[index][j * 4 + 1].color = color;
-		frame_palette[index][j * 4 + 2].color = color;
-		frame_palette[index][j * 4 + 3].color = color;
+		colors[j] = getColorFromPaletteRam(false, index, j);
 	}
-
-	return frame_palette[index];
+	return colors;
 }
 #endif
\ No newline at end of file
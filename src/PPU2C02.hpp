@@ -1,19 +1,33 @@
 #pragma once
 
-#include "Tile.hpp"
 #include "Palette.hpp"
+#include "TileCache.hpp"
 #include "Mapper/Mapper.hpp"
 #include "pch.hpp"
 
+class Bus;
+class StateArchive;
 
 class PPU2C02
 {
 public:
-	PPU2C02();
+	explicit PPU2C02(Bus& bus);
 
 	void reset();
 
-	void cycle();
+	// hands the PPU page table to the cartridge and drops the decoded tiles
+	void insertCartridge();
+
+	// Registers, latches, sprites and the picture so far. OAM, palette and
+	// nametables are part of MachineMemory and must be loaded first, and so
+	// must the mapper.
+	void serialize(StateArchive& ar);
+
+	// runs the given number of dots, whole visible scanlines at a time when
+	// they fit in
+	void run(u32 dots);
+
+	void cycle(); // one dot
 
 	u8 regRead(u16 addr);
 	void regWrite(u16 addr, u8 data);
@@ -22,29 +36,81 @@ public:
 
 	bool frame_complete = false;
 
-	const std::vector<sf::Vertex>& getVideoOutput();
+	// false leaves the video output as it is, for frames nobody will see;
+	// everything the CPU can observe, like sprite 0 hits, still happens
+	bool video_output = true;
+
+	// 256x240 pixels, row by row: the palette index in bits 0-5 and the
+	// PPUMASK emphasis bits in bits 6-8
+	const std::vector<u16>& getVideoOutput() const;
+
+	// the video output as 8 bit RGBA, 4 bytes per pixel
+	void convertVideoOutput(u8* rgba) const;
+
+	// replaces the built-in colors with a .pal file, see Palette::loadPalFile
+	void loadPalette(const std::filesystem::path& path);
+
+	// $2004 writes and OAM DMA, keeps the scanline index up to date
+	void writeOAM(u8 addr, u8 data);
 
-	u8* const OAM();
+	// a whole OAM DMA page at once, starting at addr and wrapping around
+	void writeOAMPage(u8 addr, const u8* data);
 
 	u8 getOAMAddr() const;
 
 	bool nmi = false;
 
+	// Dots until the PPU next does something the CPU can see without reading
+	// its registers: the NMI at the start of vblank, the mapper scanline counter
+	// at dot 260 while rendering, or the end of the frame.
+	u32 dotsUntilEvent() const;
+
+	// dots until sprite evaluation next reads OAM, -1 with rendering off
+	u32 dotsUntilOAMRead() const;
+
 #ifdef EMU_DEBUG
 public: // for debug
-	const std::vector<sf::Vertex>& dbgGetPatterntb(int i, u8 palette);
+	std::vector<Color> dbgGetPatterntb(int i, u8 palette); // 128x128 pixels
 	void dbgDrawNametb(u8 which);
-	const std::vector<sf::Vertex>& dbgGetFramePalette(u8 index);
+	std::array<Color, 4> dbgGetFramePalette(u8 index);
 	u8 dbg_pal = 0;
 #endif
 private:
-	sf::Color getColorFromPaletteRam(bool sprite, u16 palette, u16 pixel);
-	u8* mirroring(u16 addr);
+	Bus& bus_;
+
+	// dots 1-257 of a visible scanline, with the same memory reads in the
+	// same order as the dot by dot path
+	void renderScanline();
+
+	void fetchName();
+	void fetchAttribute();
+	u16 bgPatternAddr() const; // low bit plane of the current background tile row
+	void fetchLowerPattern();
+	void fetchUpperPattern();
+	void loadRegisters();
+	void drawBGPixel(u8& pal, u8& pat) const;
+	void shiftRegisters();
+	void incCoarseX();
+	void incY();
+	void transferX();
+	void transferY();
+	void fetch();
+	void createSprites();
+	void spriteEval();
+	void drawSprite(u8& pal, u8& pat, bool& priority, usize& sprite_idx) const;
+	void updateSpriteShifter();
+	void muxColor(u8 bg_pat, u8 bg_pal, u8 sp_pat, u8 sp_pal, bool priority, usize sprite_idx);
+
+	// the decoded row of the pattern at addr ($0000-$1FFF)
+	const u8* tileRow(u16 addr, bool flip);
+	void mapCHRPages();
+
+	u16 getPaletteIndex(bool sprite, u16 palette, u16 pixel);
+	Color getColorFromPaletteRam(bool sprite, u16 palette, u16 pixel);
 	bool renderEnable() const;
 	bool a12_toggle(u16 old_addr, u16 addr);
 
-	static constexpr std::size_t mem_size = 16 * 1024; // 16kB
-	static constexpr std::size_t primary_oam_size = 256;
+	static constexpr std::size_t primary_oam_size = MachineMemory::oam_size;
 	static constexpr std::size_t second_oam_size = 8 * 4;
 	static constexpr std::size_t resolution = 256 * 240;
 	
@@ -103,21 +169,43 @@ private:
 
 	u8 fine_x = 0;
 
-	PixelArray pixels_;
+	std::vector<u16> pixels_;
 	Palette palette_;
-	std::vector<u8> mem_, primary_oam_, second_oam_;
+
+	// parts of the bus' MachineMemory
+	std::array<u8, MachineMemory::palette_size>& palette_ram_;
+	std::array<u8, MachineMemory::vram_size>& vram_;
+	std::array<u8, primary_oam_size>& primary_oam_;
+
+	std::array<u8, second_oam_size> second_oam_{};
+	u8 second_oam_count_ = 0; // sprites
+
+	// bit n of oam_rows_[sp_size][line] is set if sprite n is in range of
+	// the line, for 8 and 16 pixel high sprites
+	std::array<std::array<u64, 256>, 2> oam_rows_{};
+	void indexOAMY(u8 sprite, u8 old_y, u8 new_y);
+	void indexOAM(); // all sprites from scratch
+	void spriteEvalFull();
 	u8 oam_addr_ = 0;
 
 	struct Sprite
 	{
 		u8 palette;
 		u8 x;
-		u8 pat_high, pat_low;
+		std::array<u8, 8> row; // 2 bit pixels, left to right
+		u8 col; // the pixel of the row the dot by dot path draws next
 		bool priority;
 		bool is_sprite0;
 	};
 
-	std::vector<Sprite> sprite_buf_;
+	std::array<Sprite, 8> sprite_buf_{};
+	u8 sprite_count_ = 0;
+
+	std::array<PPUPage, PPUPage::count> ppu_pages_{};
+
+	TileCache tiles_;
+	std::array<usize, 8> chr_pages_{}; // CHR offset of each 1KB page of $0000-$1FFF
+	u32 chr_generation_ = 0;
 	bool sprite_hit_potential_ = false;
 
 	u8 data_buf_ = 0;
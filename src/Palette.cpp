@@ -1,89 +1,166 @@
 #include "Palette.hpp"
 
+#include <cstring>
+
 Palette::Palette() : 
-	ram_(ram_size),
 	palette_(palette_size)
 {
-	palette_[0x00] = sf::Color(84, 84, 84);
-	palette_[0x01] = sf::Color(0, 30, 116);
-	palette_[0x02] = sf::Color(8, 16, 144);
-	palette_[0x03] = sf::Color(48, 0, 136);
-	palette_[0x04] = sf::Color(68, 0, 100);
-	palette_[0x05] = sf::Color(92, 0, 48);
-	palette_[0x06] = sf::Color(84, 4, 0);
-	palette_[0x07] = sf::Color(60, 24, 0);
-	palette_[0x08] = sf::Color(32, 42, 0);
-	palette_[0x09] = sf::Color(8, 58, 0);
-	palette_[0x0A] = sf::Color(0, 64, 0);
-	palette_[0x0B] = sf::Color(0, 60, 0);
-	palette_[0x0C] = sf::Color(0, 50, 60);
-	palette_[0x0D] = sf::Color(0, 0, 0);
-	palette_[0x0E] = sf::Color(0, 0, 0);
-	palette_[0x0F] = sf::Color(0, 0, 0);
-
-	palette_[0x10] = sf::Color(152, 150, 152);
-	palette_[0x11] = sf::Color(8, 76, 196);
-	palette_[0x12] = sf::Color(48, 50, 236);
-	palette_[0x13] = sf::Color(92, 30, 228);
-	palette_[0x14] = sf::Color(136, 20, 176);
-	palette_[0x15] = sf::Color(160, 20, 100);
-	palette_[0x16] = sf::Color(152, 34, 32);
-	palette_[0x17] = sf::Color(120, 60, 0);
-	palette_[0x18] = sf::Color(84, 90, 0);
-	palette_[0x19] = sf::Color(40, 114, 0);
-	palette_[0x1A] = sf::Color(8, 124, 0);
-	palette_[0x1B] = sf::Color(0, 118, 40);
-	palette_[0x1C] = sf::Color(0, 102, 120);
-	palette_[0x1D] = sf::Color(0, 0, 0);
-	palette_[0x1E] = sf::Color(0, 0, 0);
-	palette_[0x1F] = sf::Color(0, 0, 0);
-
-	palette_[0x20] = sf::Color(236, 238, 236);
-	palette_[0x21] = sf::Color(76, 154, 236);
-	palette_[0x22] = sf::Color(120, 124, 236);
-	palette_[0x23] = sf::Color(176, 98, 236);
-	palette_[0x24] = sf::Color(228, 84, 236);
-	palette_[0x25] = sf::Color(236, 88, 180);
-	palette_[0x26] = sf::Color(236, 106, 100);
-	palette_[0x27] = sf::Color(212, 136, 32);
-	palette_[0x28] = sf::Color(160, 170, 0);
-	palette_[0x29] = sf::Color(116, 196, 0);
-	palette_[0x2A] = sf::Color(76, 208, 32);
-	palette_[0x2B] = sf::Color(56, 204, 108);
-	palette_[0x2C] = sf::Color(56, 180, 204);
-	palette_[0x2D] = sf::Color(60, 60, 60);
-	palette_[0x2E] = sf::Color(0, 0, 0);
-	palette_[0x2F] = sf::Color(0, 0, 0);
-
-	palette_[0x30] = sf::Color(236, 238, 236);
-	palette_[0x31] = sf::Color(168, 204, 236);
-	palette_[0x32] = sf::Color(188, 188, 236);
-	palette_[0x33] = sf::Color(212, 178, 236);
-	palette_[0x34] = sf::Color(236, 174, 236);
-	palette_[0x35] = sf::Color(236, 174, 212);
-	palette_[0x36] = sf::Color(236, 180, 176);
-	palette_[0x37] = sf::Color(228, 196, 144);
-	palette_[0x38] = sf::Color(204, 210, 120);
-	palette_[0x39] = sf::Color(180, 222, 120);
-	palette_[0x3A] = sf::Color(168, 226, 144);
-	palette_[0x3B] = sf::Color(152, 226, 180);
-	palette_[0x3C] = sf::Color(160, 214, 228);
-	palette_[0x3D] = sf::Color(160, 162, 160);
-	palette_[0x3E] = sf::Color(0, 0, 0);
-	palette_[0x3F] = sf::Color(0, 0, 0);
+	palette_[0x00] = Color{ 84, 84, 84 };
+	palette_[0x01] = Color{ 0, 30, 116 };
+	palette_[0x02] = Color{ 8, 16, 144 };
+	palette_[0x03] = Color{ 48, 0, 136 };
+	palette_[0x04] = Color{ 68, 0, 100 };
+	palette_[0x05] = Color{ 92, 0, 48 };
+	palette_[0x06] = Color{ 84, 4, 0 };
+	palette_[0x07] = Color{ 60, 24, 0 };
+	palette_[0x08] = Color{ 32, 42, 0 };
+	palette_[0x09] = Color{ 8, 58, 0 };
+	palette_[0x0A] = Color{ 0, 64, 0 };
+	palette_[0x0B] = Color{ 0, 60, 0 };
+	palette_[0x0C] = Color{ 0, 50, 60 };
+	palette_[0x0D] = Color{ 0, 0, 0 };
+	palette_[0x0E] = Color{ 0, 0, 0 };
+	palette_[0x0F] = Color{ 0, 0, 0 };
+
+	palette_[0x10] = Color{ 152, 150, 152 };
+	palette_[0x11] = Color{ 8, 76, 196 };
+	palette_[0x12] = Color{ 48, 50, 236 };
+	palette_[0x13] = Color{ 92, 30, 228 };
+	palette_[0x14] = Color{ 136, 20, 176 };
+	palette_[0x15] = Color{ 160, 20, 100 };
+	palette_[0x16] = Color{ 152, 34, 32 };
+	palette_[0x17] = Color{ 120, 60, 0 };
+	palette_[0x18] = Color{ 84, 90, 0 };
+	palette_[0x19] = Color{ 40, 114, 0 };
+	palette_[0x1A] = Color{ 8, 124, 0 };
+	palette_[0x1B] = Color{ 0, 118, 40 };
+	palette_[0x1C] = Color{ 0, 102, 120 };
+	palette_[0x1D] = Color{ 0, 0, 0 };
+	palette_[0x1E] = Color{ 0, 0, 0 };
+	palette_[0x1F] = Color{ 0, 0, 0 };
+
+	palette_[0x20] = Color{ 236, 238, 236 };
+	palette_[0x21] = Color{ 76, 154, 236 };
+	palette_[0x22] = Color{ 120, 124, 236 };
+	palette_[0x23] = Color{ 176, 98, 236 };
+	palette_[0x24] = Color{ 228, 84, 236 };
+	palette_[0x25] = Color{ 236, 88, 180 };
+	palette_[0x26] = Color{ 236, 106, 100 };
+	palette_[0x27] = Color{ 212, 136, 32 };
+	palette_[0x28] = Color{ 160, 170, 0 };
+	palette_[0x29] = Color{ 116, 196, 0 };
+	palette_[0x2A] = Color{ 76, 208, 32 };
+	palette_[0x2B] = Color{ 56, 204, 108 };
+	palette_[0x2C] = Color{ 56, 180, 204 };
+	palette_[0x2D] = Color{ 60, 60, 60 };
+	palette_[0x2E] = Color{ 0, 0, 0 };
+	palette_[0x2F] = Color{ 0, 0, 0 };
+
+	palette_[0x30] = Color{ 236, 238, 236 };
+	palette_[0x31] = Color{ 168, 204, 236 };
+	palette_[0x32] = Color{ 188, 188, 236 };
+	palette_[0x33] = Color{ 212, 178, 236 };
+	palette_[0x34] = Color{ 236, 174, 236 };
+	palette_[0x35] = Color{ 236, 174, 212 };
+	palette_[0x36] = Color{ 236, 180, 176 };
+	palette_[0x37] = Color{ 228, 196, 144 };
+	palette_[0x38] = Color{ 204, 210, 120 };
+	palette_[0x39] = Color{ 180, 222, 120 };
+	palette_[0x3A] = Color{ 168, 226, 144 };
+	palette_[0x3B] = Color{ 152, 226, 180 };
+	palette_[0x3C] = Color{ 160, 214, 228 };
+	palette_[0x3D] = Color{ 160, 162, 160 };
+	palette_[0x3E] = Color{ 0, 0, 0 };
+	palette_[0x3F] = Color{ 0, 0, 0 };
+
+	buildLUT();
 }
 
-u8& Palette::operator[](u16 addr)
+u16 Palette::ramIndex(u16 addr)
 {
 	addr &= 0x1F;
 
-	if (addr == 0x10 || addr == 0x14 || addr == 0x18 || addr == 0x1C)
+	// $3F10/$3F14/$3F18/$3F1C mirror $3F00/$3F04/$3F08/$3F0C
+	if ((addr & 0x13) == 0x10)
 		addr &= 0x0F;
 
-	return ram_[addr];
+	return addr;
 }
 
-sf::Color Palette::getColor(const u8 index) const
+Color Palette::getColor(const u8 index) const
 {
 	return palette_[index];
 }
+
+void Palette::loadPalFile(const std::filesystem::path& path)
+{
+	std::ifstream file;
+	file.exceptions(std::ios::failbit | std::ios::badbit);
+
+	file.open(path, std::ios::binary);
+
+	const std::vector<u8> data(std::istreambuf_iterator<char>(file), {});
+	if (data.size() != palette_size * 3 && data.size() != lut_size * 3)
+	{
+		throw std::runtime_error{ "Palette file must hold 64 or 512 RGB colors" };
+	}
+
+	for (std::size_t i = 0; i < palette_size; i++)
+	{
+		palette_[i] = Color{ data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2] };
+	}
+	buildLUT();
+
+	if (data.size() == lut_size * 3)
+	{
+		for (std::size_t i = 0; i < lut_size; i++)
+		{
+			lut_[i] = packRGBA(Color{ data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2] });
+		}
+	}
+}
+
+u32 Palette::packRGBA(const Color color)
+{
+	const u8 bytes[4] = { color.r, color.g, color.b, color.a };
+	u32 rgba = 0;
+	std::memcpy(&rgba, bytes, sizeof(rgba));
+	return rgba;
+}
+
+void Palette::buildLUT()
+{
+	// each emphasis bit dims the other two channels, so with all three set
+	// every channel is dimmed
+	const auto dim = [](const u8 channel, const std::size_t emphasis, const std::size_t bit) -> u8
+	{
+		if (emphasis == 0 || (emphasis != 0x07 && (emphasis & bit)))
+		{
+			return channel;
+		}
+		return static_cast<u8>(channel * emphasis_attenuation + 0.5f);
+	};
+
+	for (std::size_t emphasis = 0; emphasis < 8; emphasis++)
+	{
+		for (std::size_t i = 0; i < palette_size; i++)
+		{
+			const Color& color = palette_[i];
+			lut_[emphasis * palette_size + i] = packRGBA(Color{
+				dim(color.r, emphasis, 0x01),
+				dim(color.g, emphasis, 0x02),
+				dim(color.b, emphasis, 0x04) });
+		}
+	}
+}
+
+void Palette::toRGBA(const u16* const pixels, const usize count, u8* const rgba) const
+{
+	// one table load and one 4 byte store per pixel, unrolled by the compiler
+	const u32* const lut = lut_.data();
+	for (usize i = 0; i < count; ++i)
+	{
+		const u32 color = lut[pixels[i] & (lut_size - 1)];
+		std::memcpy(rgba + i * 4, &color, sizeof(color));
+	}
+}
@@ -3,19 +3,44 @@
 #include "pch.hpp"
 
 
+struct Color
+{
+	u8 r = 0;
+	u8 g = 0;
+	u8 b = 0;
+	u8 a = 255;
+};
+
 class Palette
 {
 public:
+	static constexpr usize lut_size = 512; // 64 colors x 8 emphasis combinations
+
 	Palette();
 
-	u8& operator[](u16 addr);
+	// the index into palette RAM ($3F00-$3F1F, see MachineMemory) of addr
+	static u16 ramIndex(u16 addr);
+
+	Color getColor(u8 index) const;
 
-	sf::Color getColor(u8 index) const;
+	// Loads a .pal file: 64 RGB triples, with emphasis derived from them, or
+	// 512 triples that already hold the 8 emphasis variants. Throws
+	// std::runtime_error if the file cannot be used.
+	void loadPalFile(const std::filesystem::path& path);
+
+	// Converts PPU output (palette index in bits 0-5, emphasis in bits 6-8) to
+	// 8 bit RGBA, 4 bytes per pixel.
+	void toRGBA(const u16* pixels, usize count, u8* rgba) const;
 
 private:
-	static constexpr std::size_t ram_size = 32;
 	static constexpr std::size_t palette_size = 64;
 
-	std::vector<u8> ram_;
-	std::vector<sf::Color> palette_;
+	// an emphasized color keeps the emphasized channels and dims the others
+	static constexpr float emphasis_attenuation = 0.746f;
+
+	static u32 packRGBA(Color color);
+	void buildLUT();
+
+	std::vector<Color> palette_;
+	std::array<u32, lut_size> lut_{}; // RGBA bytes in memory order
 };
\ No newline at end of file
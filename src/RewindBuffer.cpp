@@ -0,0 +1,322 @@
+#include "RewindBuffer.hpp"
+
+#include <cstring>
+
+
+static usize putVarint(u8* const out, usize value)
+{
+	usize n = 0;
+	while (value >= 0x80)
+	{
+		out[n++] = static_cast<u8>(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = static_cast<u8>(value);
+	return n;
+}
+
+static usize getVarint(const u8* const in, usize& pos)
+{
+	usize value = 0;
+	for (unsigned shift = 0;; shift += 7)
+	{
+		const u8 byte = in[pos++];
+		value |= static_cast<usize>(byte & 0x7F) << shift;
+		if (byte < 0x80)
+		{
+			return value;
+		}
+	}
+}
+
+// a token is two varints, unchanged bytes to skip and literal bytes to XOR in
+static constexpr usize max_token_overhead = 2 * 10;
+
+RewindBuffer::RewindBuffer(NESCore& core, const usize budget, const u32 interval) :
+	core_{ core },
+	interval_{ std::max(interval, 1u) },
+	store_(budget)
+{
+	clear();
+	worker_ = std::thread{ &RewindBuffer::work, this };
+}
+
+RewindBuffer::~RewindBuffer()
+{
+	{
+		std::lock_guard lock{ mutex_ };
+		quit_ = true;
+	}
+	work_cv_.notify_one();
+	worker_.join();
+}
+
+void RewindBuffer::frameDone()
+{
+	const auto start = std::chrono::steady_clock::now();
+	++frame_;
+	if (frame_ % interval_ == 0)
+	{
+		std::unique_lock lock{ mutex_ };
+		if (pending_ == slot_count)
+		{
+			++dropped_;
+		}
+		else
+		{
+			// the worker only touches pending slots, so this one can be written unlocked
+			Slot& slot = slots_[(head_ + pending_) % slot_count];
+			lock.unlock();
+			const usize size = core_.saveState(slot.state.data(), slot.state.size());
+			slot.frame = frame_;
+			lock.lock();
+			if (size != slot.state.size())
+			{
+				++dropped_;
+			}
+			else
+			{
+				++pending_;
+				work_cv_.notify_one();
+			}
+		}
+	}
+	capture_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	++captured_frames_;
+}
+
+u32 RewindBuffer::rewind(const u32 frames)
+{
+	std::unique_lock lock{ mutex_ };
+	waitIdle(lock);
+	if (entries_.empty() || frames == 0)
+	{
+		return 0;
+	}
+
+	u64 target = frame_ - std::min<u64>(frames, frame_);
+	auto it = std::upper_bound(entries_.begin(), entries_.end(), target,
+		[](const u64 frame, const Entry& entry) { return frame < entry.frame; });
+	if (it == entries_.begin())
+	{
+		target = it->frame;
+	}
+	else
+	{
+		--it;
+	}
+
+	// the oldest entry is always a keyframe
+	const usize index = static_cast<usize>(it - entries_.begin());
+	usize key = index;
+	while (!entries_[key].keyframe)
+	{
+		--key;
+	}
+	std::fill(prev_.begin(), prev_.end(), u8{ 0 });
+	for (usize i = key; i <= index; ++i)
+	{
+		decode(&store_[entries_[i].offset], entries_[i].size, prev_.data());
+	}
+
+	entries_.erase(entries_.begin() + static_cast<std::ptrdiff_t>(index) + 1, entries_.end());
+	store_end_ = entries_.back().offset + entries_.back().size;
+	since_keyframe_ = static_cast<u32>(index - key);
+	force_keyframe_ = false;
+	const u64 from = entries_.back().frame;
+	lock.unlock();
+
+	core_.loadState(prev_.data(), state_size_);
+	for (u64 frame = from; frame < target; ++frame)
+	{
+		core_.runFrame();
+	}
+	const u32 back = static_cast<u32>(frame_ - target);
+	frame_ = target;
+	return back;
+}
+
+void RewindBuffer::clear()
+{
+	std::unique_lock lock{ mutex_ };
+	waitIdle(lock);
+	entries_.clear();
+	store_end_ = 0;
+	force_keyframe_ = true;
+
+	// another ROM may have a state of another size
+	state_size_ = core_.saveState(nullptr, 0);
+	for (Slot& slot : slots_)
+	{
+		slot.state.resize(state_size_);
+	}
+	prev_.resize(state_size_);
+	scratch_.resize(state_size_ + (state_size_ / min_zero_run + 1) * max_token_overhead);
+}
+
+RewindBuffer::Stats RewindBuffer::stats() const
+{
+	std::lock_guard lock{ mutex_ };
+	Stats stats;
+	for (const Entry& entry : entries_)
+	{
+		stats.bytes += entry.size;
+	}
+	if (!entries_.empty())
+	{
+		stats.seconds = static_cast<double>(entries_.back().frame - entries_.front().frame + interval_) / frame_rate;
+		stats.bytes_per_second = static_cast<double>(stats.bytes) / stats.seconds;
+	}
+	if (captured_frames_ > 0)
+	{
+		stats.capture_us = capture_seconds_ / static_cast<double>(captured_frames_) * 1e6;
+	}
+	if (snapshots_ > 0)
+	{
+		stats.compress_us = compress_seconds_ / static_cast<double>(snapshots_) * 1e6;
+	}
+	stats.snapshots = snapshots_;
+	stats.dropped = dropped_;
+	return stats;
+}
+
+void RewindBuffer::work()
+{
+	std::unique_lock lock{ mutex_ };
+	while (true)
+	{
+		work_cv_.wait(lock, [this] { return quit_ || pending_ > 0; });
+		if (quit_)
+		{
+			return;
+		}
+		busy_ = true;
+		const Slot& slot = slots_[head_];
+		lock.unlock();
+		store(slot);
+		lock.lock();
+		head_ = (head_ + 1) % slot_count;
+		--pending_;
+		busy_ = false;
+		if (pending_ == 0)
+		{
+			idle_cv_.notify_all();
+		}
+	}
+}
+
+void RewindBuffer::store(const Slot& slot)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const bool keyframe = force_keyframe_ || since_keyframe_ + 1 >= keyframe_interval;
+	const usize size = encode(slot.state.data(), keyframe ? nullptr : prev_.data(), state_size_, scratch_.data());
+	std::memcpy(prev_.data(), slot.state.data(), state_size_);
+
+	std::lock_guard lock{ mutex_ };
+	const auto overlaps = [](const Entry& entry, const usize offset, const usize size)
+	{
+		return entry.offset < offset + size && offset < entry.offset + entry.size;
+	};
+	usize offset = store_end_;
+	if (size <= store_.size() && offset + size > store_.size())
+	{
+		// wrap around: everything behind the newest entry is older than what is at the start
+		while (!entries_.empty() && entries_.front().offset >= store_end_)
+		{
+			evictOldest();
+		}
+		offset = 0;
+	}
+	while (!entries_.empty() && overlaps(entries_.front(), offset, size))
+	{
+		evictOldest();
+	}
+	if (size > store_.size() || (!keyframe && entries_.empty()))
+	{
+		// a delta whose keyframe was just evicted is useless
+		++dropped_;
+		force_keyframe_ = true;
+		return;
+	}
+
+	std::memcpy(&store_[offset], scratch_.data(), size);
+	entries_.push_back({ slot.frame, offset, size, keyframe });
+	store_end_ = offset + size;
+	since_keyframe_ = keyframe ? 0 : since_keyframe_ + 1;
+	force_keyframe_ = false;
+	++snapshots_;
+	compress_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RewindBuffer::evictOldest()
+{
+	// the deltas after a keyframe go with it
+	entries_.pop_front();
+	while (!entries_.empty() && !entries_.front().keyframe)
+	{
+		entries_.pop_front();
+	}
+}
+
+void RewindBuffer::waitIdle(std::unique_lock<std::mutex>& lock)
+{
+	idle_cv_.wait(lock, [this] { return pending_ == 0 && !busy_; });
+}
+
+usize RewindBuffer::encode(const u8* const cur, const u8* const prev, const usize size, u8* const out)
+{
+	const auto delta = [cur, prev](const usize i)
+	{
+		return prev ? static_cast<u8>(cur[i] ^ prev[i]) : cur[i];
+	};
+
+	usize n = 0;
+	usize pos = 0;
+	while (pos < size)
+	{
+		const usize zeros_start = pos;
+		while (pos < size && delta(pos) == 0)
+		{
+			++pos;
+		}
+
+		// the literal ends at the last changed byte before min_zero_run unchanged ones
+		usize literal_end = pos;
+		usize run = 0;
+		for (usize i = pos; i < size; ++i)
+		{
+			if (delta(i) != 0)
+			{
+				run = 0;
+				literal_end = i + 1;
+			}
+			else if (++run == min_zero_run)
+			{
+				break;
+			}
+		}
+
+		n += putVarint(out + n, pos - zeros_start);
+		n += putVarint(out + n, literal_end - pos);
+		for (; pos < literal_end; ++pos)
+		{
+			out[n++] = delta(pos);
+		}
+	}
+	return n;
+}
+
+void RewindBuffer::decode(const u8* const in, const usize in_size, u8* const state)
+{
+	usize pos = 0;
+	usize in_pos = 0;
+	while (in_pos < in_size)
+	{
+		pos += getVarint(in, in_pos);
+		const usize literal = getVarint(in, in_pos);
+		for (usize i = 0; i < literal; ++i)
+		{
+			state[pos++] ^= in[in_pos++];
+		}
+	}
+}
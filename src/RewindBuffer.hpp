@@ -0,0 +1,120 @@
+#pragma once
+
+#include "pch.hpp"
+#include "NESCore.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+
+// Save states of the last stretch of play in a fixed memory budget, for
+// stepping the console back in time.
+//
+// Every interval frames the emulation thread saves a state into one of a few
+// preallocated slots and goes on; a worker thread stores it as the XOR against
+// the state before it, run length coded, which leaves a few KB since most of
+// the console does not change between two snapshots. Every keyframe_interval
+// snapshots one is coded against zero instead, so a snapshot is rebuilt from
+// its keyframe and the deltas after it. When the budget is full the oldest
+// keyframe goes together with its deltas.
+class RewindBuffer
+{
+public:
+	static constexpr usize default_budget = 64 * 1024 * 1024;
+	static constexpr u32 default_interval = 4;
+	static constexpr u32 keyframe_interval = 64; // snapshots
+
+	struct Stats
+	{
+		usize bytes = 0;          // of compressed snapshots held
+		double seconds = 0.0;     // of play they reach back
+		double bytes_per_second = 0.0;
+		double capture_us = 0.0;  // emulation thread time per frame
+		double compress_us = 0.0; // worker time per snapshot
+		u64 snapshots = 0;
+		u64 dropped = 0;          // because the worker was behind or the state did not fit
+	};
+
+	// the ROM has to be loaded already
+	explicit RewindBuffer(NESCore& core, usize budget = default_budget, u32 interval = default_interval);
+	~RewindBuffer();
+
+	RewindBuffer(const RewindBuffer&) = delete;
+	RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+	// call once after every frame the console ran forward
+	void frameDone();
+
+	// Loads the last snapshot at or before `frames` frames ago and runs the
+	// console forward from it to that frame. Stops at the oldest snapshot;
+	// returns how many frames it went back. Everything newer is dropped.
+	u32 rewind(u32 frames);
+
+	// drops the whole history, for after loading a ROM or a save state
+	void clear();
+
+	Stats stats() const;
+
+private:
+	static constexpr usize slot_count = 4;
+	static constexpr usize min_zero_run = 8; // shorter runs of unchanged bytes stay in a literal
+	static constexpr double frame_rate = 60.0988;
+
+	struct Entry
+	{
+		u64 frame = 0;
+		usize offset = 0; // in store_
+		usize size = 0;
+		bool keyframe = false;
+	};
+
+	struct Slot
+	{
+		std::vector<u8> state;
+		u64 frame = 0;
+	};
+
+	void work();
+	void store(const Slot& slot);
+	void evictOldest();
+	void waitIdle(std::unique_lock<std::mutex>& lock);
+
+	// prev == nullptr codes against zero
+	static usize encode(const u8* cur, const u8* prev, usize size, u8* out);
+	static void decode(const u8* in, usize in_size, u8* state);
+
+	NESCore& core_;
+	const u32 interval_;
+	usize state_size_ = 0;
+	u64 frame_ = 0;
+
+	// slots handed to the worker: [head_, head_ + pending_) in ring order
+	mutable std::mutex mutex_;
+	std::condition_variable work_cv_;
+	std::condition_variable idle_cv_;
+	std::array<Slot, slot_count> slots_;
+	usize head_ = 0;
+	usize pending_ = 0;
+	bool busy_ = false;
+	bool quit_ = false;
+
+	// owned by the worker while it runs, by rewind() while it is idle
+	std::vector<u8> prev_;    // the last stored state
+	std::vector<u8> scratch_; // worst case encoding of one state
+	u32 since_keyframe_ = 0;
+	bool force_keyframe_ = true;
+
+	// guarded by mutex_
+	std::vector<u8> store_;
+	std::deque<Entry> entries_;
+	usize store_end_ = 0; // where the next entry goes
+
+	u64 snapshots_ = 0;
+	u64 dropped_ = 0;
+	double capture_seconds_ = 0.0;
+	u64 captured_frames_ = 0;
+	double compress_seconds_ = 0.0;
+
+	std::thread worker_;
+};
@@ -0,0 +1,91 @@
+#include "RunAhead.hpp"
+
+
+RunAhead::RunAhead(NESCore& core, const u32 frames) :
+	core_{ core }
+{
+	const usize state_size = core_.saveState(nullptr, 0);
+	for (auto& state : states_)
+	{
+		state.resize(state_size);
+	}
+	setFrames(frames);
+}
+
+void RunAhead::setFrames(const u32 frames)
+{
+	clear();
+	frames_ = std::min(frames, max_frames);
+}
+
+u32 RunAhead::frames() const
+{
+	return frames_;
+}
+
+void RunAhead::runFrame()
+{
+	++stats_.frames;
+	if (frames_ == 0)
+	{
+		core_.runFrame();
+		++stats_.emulated;
+		return;
+	}
+
+	const u8 buttons = core_.buttons();
+	if (ahead_ == frames_ && buttons == buttons_)
+	{
+		// the oldest frame run ahead is the real next frame
+		core_.playHeldAudio();
+		core_.saveState(states_[base_].data(), states_[base_].size());
+		base_ = (base_ + 1) % frames_;
+		core_.runFrame();
+		++stats_.emulated;
+		return;
+	}
+
+	if (ahead_ > 0)
+	{
+		// the state holds the buttons of back then
+		core_.loadState(states_[base_].data(), states_[base_].size());
+		core_.setButtons(buttons);
+		core_.dropHeldAudio();
+		++stats_.rollbacks;
+	}
+	core_.holdAudio(false);
+	core_.setVideoOutput(false);
+	core_.runFrame();
+
+	core_.holdAudio(true);
+	for (u32 i = 0; i < frames_; ++i)
+	{
+		auto& state = states_[(base_ + i) % frames_];
+		core_.saveState(state.data(), state.size());
+		core_.setVideoOutput(i + 1 == frames_);
+		core_.runFrame();
+	}
+	stats_.emulated += 1 + frames_;
+	ahead_ = frames_;
+	buttons_ = buttons;
+}
+
+void RunAhead::clear()
+{
+	if (ahead_ > 0)
+	{
+		const u8 buttons = core_.buttons();
+		core_.loadState(states_[base_].data(), states_[base_].size());
+		core_.setButtons(buttons);
+		ahead_ = 0;
+	}
+	core_.dropHeldAudio();
+	core_.holdAudio(false);
+	core_.setVideoOutput(true);
+	base_ = 0;
+}
+
+RunAhead::Stats RunAhead::stats() const
+{
+	return stats_;
+}
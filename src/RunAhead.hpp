@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.hpp"
+#include "NESCore.hpp"
+
+
+// Hides frames of input latency: every frame the console runs one frame for
+// real and then `frames` more with the same buttons, and the last of those is
+// what is shown. The next frame goes back to the real one before it runs.
+//
+// The frames run ahead are kept as save states, and their audio is held back.
+// If the buttons have not changed they are exactly what the real timeline
+// would run, so instead of going back the oldest one becomes real: its audio
+// is played and a single frame is run. Only frames that turn out real are
+// heard; only the shown one produces video.
+class RunAhead
+{
+public:
+	static constexpr u32 max_frames = 4;
+
+	struct Stats
+	{
+		u64 frames = 0;    // shown
+		u64 emulated = 0;  // frames the console ran for them
+		u64 rollbacks = 0; // times the buttons changed
+	};
+
+	// the ROM has to be loaded already
+	explicit RunAhead(NESCore& core, u32 frames = 1);
+
+	// how many frames ahead to run, at most max_frames; 0 runs plain frames
+	void setFrames(u32 frames);
+	u32 frames() const;
+
+	// Runs the console one real frame forward with the current buttons and
+	// leaves the picture of frames() frames later in the frame buffer.
+	void runFrame();
+
+	// Goes back to the last real frame and forgets the frames run ahead. Call
+	// before changing the console from outside, like loading a state.
+	void clear();
+
+	Stats stats() const;
+
+private:
+	NESCore& core_;
+	u32 frames_ = 0;
+
+	// the states of the real frame and the frames run ahead but the last,
+	// oldest at base_; the console itself is ahead_ frames past the oldest
+	std::array<std::vector<u8>, max_frames> states_;
+	u32 base_ = 0;
+	u32 ahead_ = 0;
+	u8 buttons_ = 0; // the frames run ahead ran with
+
+	Stats stats_;
+};
@@ -0,0 +1,131 @@
+#include "StateArchive.hpp"
+
+#include <cstring>
+
+
+StateArchive::StateArchive(u8* const out, const u8* const in, const usize size) :
+	out_{ out },
+	in_{ in },
+	size_{ size }
+{
+}
+
+StateArchive StateArchive::writer(u8* const buffer, const usize size)
+{
+	StateArchive ar{ buffer, nullptr, size };
+	u32 header[] = { magic, format_version };
+	ar.bytes(header, sizeof(header));
+	return ar;
+}
+
+StateArchive StateArchive::reader(const u8* const data, const usize size)
+{
+	StateArchive ar{ nullptr, data, size };
+	u32 header[2]{};
+	if (size < header_size)
+	{
+		throw std::runtime_error{ "Save state is too small" };
+	}
+	std::memcpy(header, data, sizeof(header));
+	if (header[0] != magic)
+	{
+		throw std::runtime_error{ "Not a save state" };
+	}
+	if (header[1] == 0 || header[1] > format_version)
+	{
+		throw std::runtime_error{ "Save state is from a newer version" };
+	}
+
+	// check the section list once, so a section lookup cannot run off the end
+	for (usize pos = header_size; pos < size;)
+	{
+		u32 section[3]{};
+		if (size - pos < section_header_size)
+		{
+			throw std::runtime_error{ "Save state is truncated" };
+		}
+		std::memcpy(section, data + pos, sizeof(section));
+		pos += section_header_size;
+		if (size - pos < section[2])
+		{
+			throw std::runtime_error{ "Save state is truncated" };
+		}
+		pos += section[2];
+	}
+	return ar;
+}
+
+bool StateArchive::loading() const
+{
+	return in_ != nullptr;
+}
+
+bool StateArchive::section(const u32 tag, const u32 version)
+{
+	if (!loading())
+	{
+		u32 header[] = { tag, version, 0 }; // the size is filled in by endSection
+		section_start_ = pos_ + section_header_size;
+		section_end_ = size_;
+		version_ = version;
+		bytes(header, sizeof(header));
+		return true;
+	}
+
+	for (usize pos = header_size; pos < size_;)
+	{
+		u32 header[3]{};
+		std::memcpy(header, in_ + pos, sizeof(header));
+		pos += section_header_size;
+		if (header[0] == tag)
+		{
+			pos_ = section_start_ = pos;
+			section_end_ = pos + header[2];
+			version_ = header[1];
+			return true;
+		}
+		pos += header[2];
+	}
+	return false;
+}
+
+void StateArchive::endSection()
+{
+	if (!loading() && pos_ <= size_)
+	{
+		const u32 size = static_cast<u32>(pos_ - section_start_);
+		std::memcpy(out_ + section_start_ - sizeof(u32), &size, sizeof(size));
+	}
+}
+
+u32 StateArchive::version() const
+{
+	return version_;
+}
+
+void StateArchive::bytes(void* const data, const usize size)
+{
+	if (loading())
+	{
+		if (section_end_ - pos_ < size)
+		{
+			throw std::runtime_error{ "Save state section is truncated" };
+		}
+		std::memcpy(data, in_ + pos_, size);
+	}
+	else if (pos_ + size <= size_)
+	{
+		std::memcpy(out_ + pos_, data, size);
+	}
+	pos_ += size;
+}
+
+usize StateArchive::size() const
+{
+	return pos_;
+}
+
+bool StateArchive::fits() const
+{
+	return pos_ <= size_;
+}
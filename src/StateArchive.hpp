@@ -0,0 +1,83 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <type_traits>
+
+
+// Reads or writes a save state. Every unit lists its fields once, in a
+// serialize(StateArchive&) that does both, so saving and loading cannot drift
+// apart. Values are copied in host byte order.
+//
+// A state is a header and a list of sections, one per unit: a tag, the
+// version of the unit's layout and the payload size. Loading looks sections
+// up by tag, skips the ones it does not know and hands the stored version to
+// the unit, so a unit that adds fields bumps its version and reads the old
+// layout when it finds an older one.
+//
+// Writing never allocates. If the state does not fit the buffer nothing past
+// the end is written and size() still counts the whole state.
+class StateArchive
+{
+public:
+	static constexpr u32 magic = 0x5353454E; // "NESS"
+	static constexpr u32 format_version = 1;
+
+	static constexpr u32 tag(const char (&name)[5])
+	{
+		return static_cast<u32>(static_cast<u8>(name[0]))
+			| static_cast<u32>(static_cast<u8>(name[1])) << 8
+			| static_cast<u32>(static_cast<u8>(name[2])) << 16
+			| static_cast<u32>(static_cast<u8>(name[3])) << 24;
+	}
+
+	static StateArchive writer(u8* buffer, usize size);
+
+	// throws std::runtime_error if data does not hold a state this build can read
+	static StateArchive reader(const u8* data, usize size);
+
+	bool loading() const;
+
+	// Starts the section `tag`. Saving writes its header and always returns
+	// true; loading moves to it and returns false if the state has none.
+	bool section(u32 tag, u32 version);
+	void endSection();
+
+	// the layout version of the current section
+	u32 version() const;
+
+	template<typename... T>
+	void operator()(T&... values)
+	{
+		(value(values), ...);
+	}
+
+	// throws std::runtime_error if the section ends before size bytes
+	void bytes(void* data, usize size);
+
+	// the bytes the state takes, written or not
+	usize size() const;
+
+	bool fits() const;
+
+private:
+	StateArchive(u8* out, const u8* in, usize size);
+
+	template<typename T>
+	void value(T& v)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		bytes(&v, sizeof(T));
+	}
+
+	static constexpr usize header_size = 8;
+	static constexpr usize section_header_size = 12;
+
+	u8* out_;
+	const u8* in_;
+	usize size_;
+	usize pos_ = 0;
+	usize section_start_ = 0; // of the current section's payload
+	usize section_end_ = 0;   // loading only
+	u32 version_ = 0;
+};
@@ -0,0 +1,42 @@
+#include "TileCache.hpp"
+
+
+void TileCache::reset(const u8* const chr, const usize size)
+{
+	chr_ = chr;
+	const usize tiles = size / tile_size;
+	pixels_.assign(tiles * decoded_tile_size, 0);
+	valid_.assign(tiles, false);
+}
+
+const u8* TileCache::row(const usize offset, const bool flip)
+{
+	const usize tile = offset / tile_size;
+	if (!valid_[tile])
+	{
+		decode(tile);
+	}
+	return &pixels_[tile * decoded_tile_size + (flip ? 64 : 0) + (offset & 0x07) * 8];
+}
+
+void TileCache::invalidate(const usize offset)
+{
+	valid_[offset / tile_size] = false;
+}
+
+void TileCache::decode(const usize tile)
+{
+	const u8* const planes = &chr_[tile * tile_size];
+	u8* const pixels = &pixels_[tile * decoded_tile_size];
+	for (usize y = 0; y < 8; ++y)
+	{
+		for (usize x = 0; x < 8; ++x)
+		{
+			const u8 pos = static_cast<u8>(7 - x);
+			const u8 pixel = (getBitN(planes[y + 8], pos) << 1) | getBitN(planes[y], pos);
+			pixels[y * 8 + x] = pixel;
+			pixels[64 + y * 8 + (7 - x)] = pixel;
+		}
+	}
+	valid_[tile] = true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "pch.hpp"
+
+
+// CHR memory decoded into 2 bit pixel indices, one byte per pixel and 8 per
+// tile row, plus a horizontally flipped copy of every row. Tiles are decoded
+// the first time they are used and again after CHR RAM under them changed.
+class TileCache
+{
+public:
+	static constexpr usize tile_size = 16; // bytes of CHR per tile
+
+	void reset(const u8* chr, usize size);
+
+	// The 8 pixels of the row whose low bit plane is at CHR offset `offset`,
+	// left to right (right to left if flipped).
+	const u8* row(usize offset, bool flip);
+
+	void invalidate(usize offset);
+
+private:
+	void decode(usize tile);
+
+	static constexpr usize decoded_tile_size = 2 * 8 * 8; // normal and flipped rows
+
+	const u8* chr_ = nullptr;
+	std::vector<u8> pixels_;
+	std::vector<bool> valid_;
+};
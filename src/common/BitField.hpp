@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
 template<class T>
 class BitField
 {
@@ -19,14 +23,14 @@ public:
     }
 
 private:
-    template<typename T, typename U>
-    static T bit_cast(U& bit) 
+    template<typename To, typename U>
+    static To bit_cast(U& bit) 
     {
-        static_assert(sizeof(T) == sizeof(U));
-        static_assert(std::is_pod_v<T>);
+        static_assert(sizeof(To) == sizeof(U));
+        static_assert(std::is_pod_v<To>);
         static_assert(std::is_pod_v<U>);
-        T val{};
-        std::memcpy(std::addressof(val), std::addressof(bit), sizeof(T));
+        To val{};
+        std::memcpy(std::addressof(val), std::addressof(bit), sizeof(To));
         return val;
     }
 };
\ No newline at end of file
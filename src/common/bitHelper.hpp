@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 template<typename T>
 constexpr bool getBitN(const T var, const unsigned pos)
 {
@@ -17,4 +21,23 @@ constexpr void setBitN(T& var, const unsigned pos, const bool val)
 	{
 		var = var & ~(static_cast<T>(1) << pos);
 	}
-}
\ No newline at end of file
+}
+constexpr unsigned countSetBits(unsigned long long var)
+{
+	var = var - ((var >> 1) & 0x5555555555555555ull);
+	var = (var & 0x3333333333333333ull) + ((var >> 2) & 0x3333333333333333ull);
+	var = (var + (var >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return static_cast<unsigned>((var * 0x0101010101010101ull) >> 56);
+}
+
+// index of the lowest set bit, var must not be 0
+inline unsigned lowestSetBit(const unsigned long long var)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, var);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(var));
+#endif
+}
@@ -0,0 +1,376 @@
+#include "NES.hpp"
+
+#ifdef DEBUG_WINDOW
+static sf::Color toSFColor(const Color color)
+{
+    return sf::Color{ color.r, color.g, color.b, color.a };
+}
+#endif
+
+NES::NES() :
+    frame_rgba_(NESCore::screen_width * NESCore::screen_height * 4)
+#ifdef DEBUG_WINDOW
+    , dbg_patterntb_{ (128 * 128), (128 * 128) }
+#endif
+{
+    frame_texture_.create(NESCore::screen_width, NESCore::screen_height);
+    frame_sprite_.setTexture(frame_texture_);
+#ifdef DEBUG_WINDOW
+    std::size_t i = 0;
+    for (int row = 0; row < 128; ++row)
+        for (int col = 0; col < 128; ++col, ++i)
+        {
+            dbg_patterntb_[0][i].setPosition({ float(256 + 11 + col), float(11 + row) });
+            dbg_patterntb_[1][i].setPosition({ float(256 + 11 + col), float(128 + 22 + row) });
+        }
+
+    constexpr float size = 7.5f;
+    sf::Vector2f pos{ 50.0f, 250.0f };
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        dbg_palettes_[i].resize(16);
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            dbg_palettes_[i][j * 4 + 0].position = pos;
+            dbg_palettes_[i][j * 4 + 1].position = { pos.x + size, pos.y };
+            dbg_palettes_[i][j * 4 + 2].position = { pos.x + size, pos.y + size };
+            dbg_palettes_[i][j * 4 + 3].position = { pos.x, pos.y + size };
+            pos.x += size;
+        }
+
+        pos.x += size;
+        if (i == 3)
+        {
+            pos.y += size * 2;
+            pos.x = 50.0f;
+        }
+    }
+#endif
+
+#ifdef DEBUG_WINDOW
+	window_ = new sf::RenderWindow(sf::VideoMode(s_dbg_nes_width, s_dbg_nes_height), "NES", sf::Style::Titlebar | sf::Style::Close);
+#else 
+    window_ = new sf::RenderWindow(sf::VideoMode(s_nes_width, s_nes_height), "NES", sf::Style::Titlebar | sf::Style::Close);
+#endif
+    scaleWindow();
+
+    constexpr unsigned channel_count = 1;
+    initialize(channel_count, s_sample_rate);
+    core.setSampleRate(s_sample_rate);
+    samples_.resize(s_sample_rate / s_frame_rate); // one chunk per audio callback
+    setProcessingInterval(sf::Time::Zero);
+}
+
+NES::~NES()
+{
+    stop();
+	delete window_;
+}
+
+void NES::run()
+{
+    const sf::Time frame_time = sf::seconds(1.0f / static_cast<float>(s_frame_rate));
+    sf::Clock clock;
+    sf::Time deadline = clock.getElapsedTime();
+
+    rewind_ = std::make_unique<RewindBuffer>(core);
+    run_ahead_ = std::make_unique<RunAhead>(core);
+    onUpdate();
+
+    play();
+    while (window_->isOpen())
+    {
+        while (window_->pollEvent(event_))
+        {
+            onEvent();
+        }
+
+        onDraw();
+        onUpdate();
+
+        // sleep until the next frame is due; after a stall start over from
+        // now instead of running frames back to back to catch up
+        deadline += frame_time;
+        const sf::Time now = clock.getElapsedTime();
+        if (now < deadline)
+            sf::sleep(deadline - now);
+        else if (now - deadline > frame_time)
+            deadline = now;
+    }
+
+    const auto stats = core.audioStats();
+    std::printf("Audio underruns %llu, overruns %llu, %zu samples queued\n",
+        static_cast<unsigned long long>(stats.underruns), static_cast<unsigned long long>(stats.overruns), stats.fill);
+    const auto rewind = rewind_->stats();
+    std::printf("Rewind %.1f s in %zu KB (%.1f KB/s), capture %.1f us/frame, compress %.1f us/snapshot, %llu dropped\n",
+        rewind.seconds, rewind.bytes / 1024, rewind.bytes_per_second / 1024.0, rewind.capture_us, rewind.compress_us,
+        static_cast<unsigned long long>(rewind.dropped));
+    const auto run_ahead = run_ahead_->stats();
+    std::printf("Run-ahead %u frames, %.2f frames emulated per frame, %llu rollbacks\n",
+        run_ahead_->frames(), static_cast<double>(run_ahead.emulated) / static_cast<double>(std::max<u64>(run_ahead.frames, 1)),
+        static_cast<unsigned long long>(run_ahead.rollbacks));
+}
+
+bool NES::onUpdate()
+{
+    if (pause_) return true;
+
+    if (movie_mode_ == MovieMode::Recording)
+    {
+        movie_.recordFrame(core);
+        rewind_->frameDone();
+    }
+    else if (movie_mode_ == MovieMode::Playing)
+    {
+        const bool desynced = movie_.desyncFrame().has_value();
+        if (movie_.playFrame(core))
+        {
+            rewind_->frameDone();
+            if (!desynced && movie_.desyncFrame())
+                std::printf("Movie desync at frame %u\n", *movie_.desyncFrame());
+        }
+        else
+            togglePlayback();
+    }
+    else if (rewinding_)
+    {
+        run_ahead_->clear();
+        rewind_->rewind(1);
+    }
+    else
+    {
+        // the rewind history holds the frames as they were shown
+        run_ahead_->runFrame();
+        rewind_->frameDone();
+    }
+    adjustAudioRate();
+
+    return true;
+}
+
+void NES::onDraw()
+{
+    window_->clear(sf::Color{ 0, 0, 50 });
+    
+    // bus_.ppu.dbgDrawNametb(0);
+
+    core.frameToRGBA(frame_rgba_.data());
+    frame_texture_.update(frame_rgba_.data());
+    window_->draw(frame_sprite_);
+#ifdef DEBUG_WINDOW
+    PPU2C02& ppu = core.bus().ppu;
+    for (int t = 0; t < 2; ++t)
+    {
+        const auto patterntb = ppu.dbgGetPatterntb(t, ppu.dbg_pal);
+        for (std::size_t i = 0; i < patterntb.size(); ++i)
+            dbg_patterntb_[t][i].setColor(toSFColor(patterntb[i]));
+        auto& vertices = dbg_patterntb_[t].getVertexArray();
+        window_->draw(vertices.data(), vertices.size(), sf::Quads);
+    }
+    
+    for (u8 i = 0; i < 8; ++i)
+    {
+        const auto colors = ppu.dbgGetFramePalette(i);
+        for (std::size_t j = 0; j < 4; ++j)
+            for (std::size_t k = 0; k < 4; ++k)
+                dbg_palettes_[i][j * 4 + k].color = toSFColor(colors[j]);
+        window_->draw(dbg_palettes_[i].data(), dbg_palettes_[i].size(), sf::Quads);
+    }
+#endif
+    window_->display();
+}
+
+void NES::onEvent()
+{
+    switch (event_.type)
+    {
+    case sf::Event::Closed:
+        window_->close();
+        break;
+
+    case sf::Event::KeyPressed:
+        onKeyPressed();
+        break;
+
+    case sf::Event::KeyReleased:
+        onKeyReleased();
+        break;
+    }
+}
+
+void NES::onKeyPressed()
+{
+    if (event_.key.code == sf::Keyboard::Escape)
+        window_->close();
+    else if (event_.key.code == sf::Keyboard::Delete)
+    {
+        if (movie_mode_ == MovieMode::Recording)
+            movie_.reset(core);
+        else if (movie_mode_ == MovieMode::Off)
+        {
+            run_ahead_->clear();
+            core.reset();
+        }
+    }
+    else if (event_.key.code == sf::Keyboard::F5)
+        toggleRecording();
+    else if (event_.key.code == sf::Keyboard::F6)
+        togglePlayback();
+    else if (event_.key.code == sf::Keyboard::F1)
+        run_ahead_->setFrames(run_ahead_->frames() - std::min(run_ahead_->frames(), 1u));
+    else if (event_.key.code == sf::Keyboard::F2)
+        run_ahead_->setFrames(run_ahead_->frames() + 1);
+    else if (event_.key.code == sf::Keyboard::Backspace)
+        rewinding_ = movie_mode_ == MovieMode::Off;
+#ifdef DEBUG_WINDOW
+    else if (event_.key.code == sf::Keyboard::Right)
+        ++core.bus().ppu.dbg_pal &= 0x07;
+    else if (event_.key.code == sf::Keyboard::Left)
+        --core.bus().ppu.dbg_pal &= 0x07;
+    else if (event_.key.code == sf::Keyboard::Space)
+        pause_ = !pause_;
+#endif
+    else if (event_.key.code == sf::Keyboard::W)
+        core.setButton(Botton::Up, true);
+    else if (event_.key.code == sf::Keyboard::S)
+        core.setButton(Botton::Down, true);
+    else if (event_.key.code == sf::Keyboard::A)
+        core.setButton(Botton::Left, true);
+    else if (event_.key.code == sf::Keyboard::D)
+        core.setButton(Botton::Right, true);
+    else if (event_.key.code == sf::Keyboard::G)
+        core.setButton(Botton::Select, true);
+    else if (event_.key.code == sf::Keyboard::H)
+        core.setButton(Botton::Start, true);
+    else if (event_.key.code == sf::Keyboard::J)
+        core.setButton(Botton::B, true);
+    else if (event_.key.code == sf::Keyboard::K)
+        core.setButton(Botton::A, true);
+    else if (event_.key.code == sf::Keyboard::PageUp)
+    {
+        win_scale_ = std::min(win_scale_ + 1u, 10u);
+        scaleWindow();
+    }
+    else if (event_.key.code == sf::Keyboard::PageDown)
+    {
+        win_scale_ = std::max(win_scale_ - 1u, 1u);
+        scaleWindow();
+    }
+}
+
+void NES::onKeyReleased()
+{
+     if (event_.key.code == sf::Keyboard::Backspace)
+         rewinding_ = false;
+     else if (event_.key.code == sf::Keyboard::W)
+         core.setButton(Botton::Up, false);
+     else if (event_.key.code == sf::Keyboard::S)
+         core.setButton(Botton::Down, false);
+     else if (event_.key.code == sf::Keyboard::A)
+         core.setButton(Botton::Left, false);
+     else if (event_.key.code == sf::Keyboard::D)
+         core.setButton(Botton::Right, false);
+     else if (event_.key.code == sf::Keyboard::G)
+         core.setButton(Botton::Select, false);
+     else if (event_.key.code == sf::Keyboard::H)
+         core.setButton(Botton::Start, false);
+     else if (event_.key.code == sf::Keyboard::J)
+         core.setButton(Botton::B, false);
+     else if (event_.key.code == sf::Keyboard::K)
+         core.setButton(Botton::A, false);
+}
+
+void NES::adjustAudioRate()
+{
+    // Produce slightly more samples while the queue is below the target
+    // latency and slightly fewer above it. The proportional part reacts to
+    // the distance, the slowly built trim removes the offset a steady clock
+    // mismatch would leave. Never more than s_max_rate_adjust, which is
+    // inaudible.
+    const double target = s_sample_rate * s_audio_latency;
+    const double fill = static_cast<double>(core.audioStats().fill);
+    const double error = std::clamp((target - fill) / target, -1.0, 1.0);
+    rate_trim_ = std::clamp(rate_trim_ + error * s_rate_trim_gain, -s_max_rate_adjust, s_max_rate_adjust);
+    const double adjust = std::clamp(s_max_rate_adjust * error + rate_trim_, -s_max_rate_adjust, s_max_rate_adjust);
+    core.setAudioRateAdjust(1.0 + adjust);
+}
+
+void NES::toggleRecording()
+{
+    if (movie_mode_ == MovieMode::Recording)
+    {
+        movie_mode_ = MovieMode::Off;
+        try
+        {
+            movie_.save(movie_path);
+            std::printf("Recorded %u frames to %s\n", movie_.frames(), movie_path.string().c_str());
+        }
+        catch (std::exception& e)
+        {
+            std::fprintf(stderr, "%s\n", e.what());
+        }
+    }
+    else if (movie_mode_ == MovieMode::Off)
+    {
+        // starts from power on
+        run_ahead_->clear();
+        movie_.startRecording(core);
+        movie_mode_ = MovieMode::Recording;
+        std::printf("Recording a movie\n");
+    }
+}
+
+void NES::togglePlayback()
+{
+    if (movie_mode_ == MovieMode::Playing)
+    {
+        movie_mode_ = MovieMode::Off;
+        std::printf("Movie stopped at frame %u of %u, %s\n", movie_.position(), movie_.frames(),
+            movie_.desyncFrame() ? "desynced" : "in sync");
+        core.setButtons(0);
+    }
+    else if (movie_mode_ == MovieMode::Off)
+    {
+        try
+        {
+            run_ahead_->clear();
+            movie_ = Movie::load(movie_path);
+            movie_.startPlayback(core);
+            movie_mode_ = MovieMode::Playing;
+            std::printf("Playing %u frames from %s\n", movie_.frames(), movie_path.string().c_str());
+        }
+        catch (std::exception& e)
+        {
+            std::fprintf(stderr, "%s\n", e.what());
+        }
+    }
+}
+
+bool NES::onGetData(Chunk& data)
+{
+    // runs on the audio thread, pads with silence if emulation fell behind
+    const usize n = core.readSamples(samples_.data(), samples_.size());
+    std::fill(samples_.begin() + n, samples_.end(), i16{ 0 });
+    data.samples = samples_.data();
+    data.sampleCount = samples_.size();
+    return true;
+}
+
+void NES::onSeek(sf::Time)
+{
+    /* empty */
+}
+
+void NES::scaleWindow()
+{
+#ifdef DEBUG_WINDOW
+    auto size = sf::Vector2u(s_dbg_nes_width, s_dbg_nes_height);
+#else 
+    auto size = sf::Vector2u(s_nes_width, s_nes_height);
+#endif
+    size *= win_scale_;
+    window_->setSize(size);
+    const auto desktop = sf::VideoMode::getDesktopMode();
+    sf::Vector2i pos(desktop.width / 2 - size.x / 2, desktop.height / 2 - size.y / 2);
+    window_->setPosition(pos);
+}
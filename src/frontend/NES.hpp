@@ -0,0 +1,85 @@
+#pragma once
+
+#include "pch.hpp"
+#include "Tile.hpp"
+#include "NESCore.hpp"
+#include "RewindBuffer.hpp"
+#include "RunAhead.hpp"
+#include "Movie.hpp"
+
+#ifdef EMU_DEBUG
+#define DEBUG_WINDOW
+#endif
+
+class NES : public sf::SoundStream
+{
+public:
+	NES();
+	~NES();
+
+	void run();
+
+	NESCore core;
+
+	// F5 records a movie to it, F6 plays it back
+	std::filesystem::path movie_path = "movie.nesm";
+
+private:
+	static constexpr int s_sample_rate = 44100;
+	static constexpr int s_frame_rate = 60;
+	static constexpr double s_audio_latency = 0.040;    // seconds of queued audio to aim for
+	static constexpr double s_max_rate_adjust = 0.005; // of the sample rate
+	static constexpr double s_rate_trim_gain = 0.00002;
+	static constexpr unsigned s_nes_width = 256;
+	static constexpr unsigned s_nes_height = 240;
+	static constexpr unsigned s_dbg_nes_width = 256 + 150;
+	static constexpr unsigned s_dbg_nes_height = 256 + 50;
+
+	bool onUpdate();
+	void onDraw();
+	void onEvent();
+	void onKeyPressed();
+	void onKeyReleased();
+	bool onGetData(Chunk& data) override;
+	void onSeek(sf::Time) override;
+	void scaleWindow();
+	void adjustAudioRate(); // steers the audio queue toward s_audio_latency
+	void toggleRecording();
+	void togglePlayback();
+
+	// the frame is converted to RGBA once and uploaded as a single texture,
+	// the window scales it up by win_scale_
+	std::vector<u8> frame_rgba_;
+	sf::Texture frame_texture_;
+	sf::Sprite frame_sprite_;
+#ifdef DEBUG_WINDOW
+	PixelArray dbg_patterntb_[2];
+	std::vector<sf::Vertex> dbg_palettes_[8];
+#endif
+
+	sf::RenderWindow* window_ = nullptr;
+	sf::Event event_{};
+
+	sf::Sound sound_;
+
+	unsigned win_scale_ = 3;
+
+	bool pause_ = false;
+
+	std::unique_ptr<RewindBuffer> rewind_; // created once the ROM is loaded
+	std::unique_ptr<RunAhead> run_ahead_;   // F1 and F2 change how far
+	bool rewinding_ = false; // while Backspace is held
+
+	// while a movie runs, frames run through it and neither run ahead nor rewind
+	enum class MovieMode
+	{
+		Off,
+		Recording,
+		Playing
+	};
+	Movie movie_;
+	MovieMode movie_mode_ = MovieMode::Off;
+
+	std::vector<i16> samples_;
+	double rate_trim_ = 0.0;
+};
\ No newline at end of file
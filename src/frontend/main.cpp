@@ -0,0 +1,89 @@
+#include "pch.hpp"
+#include "NES.hpp"
+
+
+void trimPath(std::string& path)
+{
+    int start = 0;
+    while (start < path.size() && !std::isalpha(path[start]))
+        start++;
+    int end = path.size() - 1;
+    while (end >= start && !std::isalpha(path[end]))
+        end--;
+    if (start <= end)
+        path = path.substr(start, end - start + 1);
+}
+
+// Plays a movie as fast as possible without window or sound, for
+// reproducible benchmarks. Only the frames that are hashed produce video.
+int playMovie(const std::filesystem::path& rom_path, const std::filesystem::path& movie_path)
+{
+    try
+    {
+        NESCore core;
+        core.loadROM(rom_path);
+        Movie movie = Movie::load(movie_path);
+        movie.startPlayback(core);
+
+        const auto start = std::chrono::steady_clock::now();
+        bool desynced = false;
+        while (true)
+        {
+            core.setVideoOutput(movie.nextFrameChecked());
+            if (!movie.playFrame(core))
+                break;
+            if (!desynced && movie.desyncFrame())
+            {
+                desynced = true;
+                std::printf("Desync at frame %u\n", *movie.desyncFrame());
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%u frames in %.3f s, %.1f fps, %s\n", movie.frames(), seconds,
+            static_cast<double>(movie.frames()) / seconds, desynced ? "desynced" : "in sync");
+        return desynced ? 1 : 0;
+    }
+    catch (std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+}
+
+int main(int argc, char* argv[])
+{      
+    // --play <rom> <movie>: headless movie playback, see playMovie
+    if (argc == 4 && std::string(argv[1]) == "--play")
+        return playMovie(argv[2], argv[3]);
+
+    // optional: a .pal file to use in place of the built-in colors
+    const std::string palette_path = (argc > 1 ? argv[1] : "");
+
+    std::string cmd;
+    while (true)
+    {
+        std::cout << "Input rom directory or type \"exit\" to exit the program: ";
+        std::getline(std::cin, cmd);
+
+        if (cmd == "exit")
+            break;
+
+        trimPath(cmd);
+
+        try
+        {
+            NES nes;
+            if (!palette_path.empty())
+                nes.core.loadPalette(palette_path);
+            const u8 mapper_type = nes.core.loadROM(cmd);
+            nes.movie_path = std::filesystem::path{ cmd }.replace_extension(".nesm");
+            std::printf("Mapper %03d\n", (int)mapper_type);
+            nes.run();
+        }
+        catch (std::exception& e)
+        {
+            std::fprintf(stderr, "%s\n", e.what());
+        }
+    }
+    return 0;
+}
\ No newline at end of file